@@ -4,10 +4,76 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-extern const uint16_t AUDIO_DATA_LEN;
-extern const float32_t ADC_SAMPLING_FREQ;
-extern const float32_t ADC_SAMPLING_RATE;
+#include "signal_gate.h"
+
+#ifndef ADC_DECIMATION_FACTOR
+#define ADC_DECIMATION_FACTOR 1 // Capture rate / analysis rate, > 1 only with ADC_OVERSAMPLING
+#endif
+
+#ifdef ADC_OVERSAMPLING
+#include "decimator.h"
+#define ADC_RAW_CHUNK_LEN DECIMATOR_BLOCK_LEN // Raw ADC samples per DMA half-transfer
+#else
+#define ADC_RAW_CHUNK_LEN 128 // Raw ADC samples per DMA half-transfer
+#endif // ADC_OVERSAMPLING
+#define ADC_CHUNK_LEN (ADC_RAW_CHUNK_LEN / ADC_DECIMATION_FACTOR) // Analysis samples per DMA half-transfer
+#define AUDIO_HISTORY_LEN 8192 // Analysis samples kept by the acquisition, a power of two
+#define AUDIO_MAX_DATA_LEN 4096 // Longest analysis block, leaves one block time to process it
+
+#ifdef DUAL_INPUT
+#ifdef ADC_OVERSAMPLING
+#error "DUAL_INPUT does not support ADC_OVERSAMPLING, the decimator has a single channel"
+#endif // ADC_OVERSAMPLING
+#define AUDIO_INPUT_COUNT 2 // Inputs scanned per trigger; their samples are interleaved everywhere
+#else
+#define AUDIO_INPUT_COUNT 1
+#endif // DUAL_INPUT
+#define AUDIO_NO_ONSET UINT32_MAX
+
+typedef enum
+{
+    ADC_RATE_4KHZ,
+    ADC_RATE_8KHZ,
+    ADC_RATE_16KHZ,
+    ADC_RATE_32KHZ,
+    ADC_RATE_COUNT,
+} AdcSampleRateMode;
+
+/*
+ * An analysis block is a window of the acquisition history, addressed by absolute sample
+ * indices (ADC_SAMPLE_COUNTER units). Read it with getAudioSample(pHistory + input, ...)
+ * while it is still younger than AUDIO_HISTORY_LEN samples.
+ */
+typedef struct
+{
+    uint32_t startSample; // Index of the first sample of the block
+    uint16_t length; // Samples in the block
+    uint32_t samplesSinceOnset; // From the last detected onset to startSample, AUDIO_NO_ONSET if none
+    uint8_t input; // Input chosen for this block, always 0 without DUAL_INPUT
+    SignalGateStats gate; // Statistics of this block, taken when it was published
+} AudioBlock;
+
+extern const uint32_t ADC_SAMPLE_RATE_TABLE[ADC_RATE_COUNT]; // Requested rates in Hz
+extern const uint16_t AUDIO_DATA_LEN; // Reference block length, the default of chooseAnalysisLength()
+extern const uint8_t AUDIO_SAMPLE_BITS; // Significant bits of an analysis sample (offset binary)
+extern float32_t ADC_SAMPLING_FREQ; // Analysis rate used by all pitch math, only written from the main loop
 extern volatile bool AUDIO_DATA_IS_ACTUAL;
+extern volatile uint32_t ADC_SAMPLE_COUNTER; // Analysis samples captured since the ring was started
+extern volatile uint32_t ADC_DROPPED_BLOCKS; // Blocks replaced by a newer one before the main loop picked them up
+extern uint16_t ADC_WAKE_THRESHOLD; // Distance from the DC bias, in 12-bit LSBs, that ends waitForPluck()
+
+void setAdcSampleRate(AdcSampleRateMode mode);
+void startAdcRingRecording(uint16_t* pHistory, uint16_t blockLength);
+void stopAdcRingRecording();
+void setAdcBlockLength(uint16_t blockLength);
+AudioBlock waitForAdcBlock();
+void waitForPluck(uint16_t adcBias);
 
-void startAdcDataRecording(uint16_t* pData, uint16_t length);
-void waitForAdcData();
+/*
+ * pHistory points at the sample of the wanted input inside the first interleaved frame, so
+ * the inputs are separated by plain strided reads and never copied apart.
+ */
+static inline uint16_t getAudioSample(const uint16_t* pHistory, const uint32_t sampleIdx)
+{
+    return pHistory[(sampleIdx * AUDIO_INPUT_COUNT) & (AUDIO_HISTORY_LEN * AUDIO_INPUT_COUNT - 1)];
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+
+typedef enum
+{
+    ANALYSIS_LEN_512,
+    ANALYSIS_LEN_1024,
+    ANALYSIS_LEN_2048,
+    ANALYSIS_LEN_4096,
+    ANALYSIS_LEN_COUNT,
+} AnalysisLength;
+
+extern const uint16_t ANALYSIS_LEN_TABLE[ANALYSIS_LEN_COUNT]; // Block lengths in samples, FFT sizes
+extern const AnalysisLength ANALYSIS_LEN_DEFAULT; // Used while no pitch is known
+extern float32_t ANALYSIS_MIN_PERIODS; // Periods of the last pitch a block must hold
+
+AnalysisLength chooseAnalysisLength(float32_t lastFrequency);
+AnalysisLength findAnalysisLength(uint16_t length);
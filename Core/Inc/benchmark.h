@@ -0,0 +1,6 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+
+void runBenchmarks(uint16_t* pAudioHistory, float32_t* pScratch, q15_t* pScratchQ15);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "main.h"
+
+/*
+ * DWT cycle counter helpers. The counter runs at HCLK and wraps every 2^32 cycles,
+ * so differences of two readings are valid for intervals shorter than that.
+ */
+
+static inline void enableCycleCounter(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t getCycleCount(void)
+{
+    return DWT->CYCCNT;
+}
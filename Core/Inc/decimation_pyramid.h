@@ -0,0 +1,32 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+#include "adc_data.h"
+#include "spectrum.h"
+#include "window.h"
+
+#define PYRAMID_LEVEL_COUNT 3 // Octaves below the analysis rate: /2, /4 and /8
+#define PYRAMID_LEVEL_LEN 2048 // Samples kept per level, a power of two
+#define PYRAMID_MAX_BLOCK_LEN (PYRAMID_LEVEL_LEN / 2) // Longest block; the rest of the ring is margin for the writer
+#define PYRAMID_HALF_BAND_TAPS 32 // FIR length of every half-band stage
+
+/*
+ * A block of a pyramid level, addressed by sample indices of that level
+ * (ADC_SAMPLE_COUNTER >> level).
+ */
+typedef struct
+{
+    uint8_t level; // Decimation is 2^level, 1..PYRAMID_LEVEL_COUNT
+    uint32_t startSample; // Index of the first sample of the block in the level
+    uint16_t length; // Samples in the block, 0 when the full-rate block must be analysed instead
+} PyramidBlock;
+
+extern float32_t PYRAMID_MIN_HARMONICS; // Harmonics of the note that must fit in the band of a level
+
+void resetDecimationPyramid();
+void updateDecimationPyramid(const uint16_t* pChunk, uint32_t chunkStart);
+uint8_t choosePyramidLevel(float32_t lastFrequency);
+PyramidBlock choosePyramidBlock(float32_t lastFrequency, const AudioBlock* pBlock);
+SpectrumBand getPyramidBand(const PyramidBlock* pBlock);
+void readPyramidBlock(const PyramidBlock* pBlock, float32_t* pDst, WindowType window);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+
+#define DECIMATOR_TAPS_PER_PHASE 24 // FIR length is DECIMATOR_TAPS_PER_PHASE * decimation factor
+#define DECIMATOR_MAX_FACTOR 8
+#define DECIMATOR_MAX_TAPS (DECIMATOR_TAPS_PER_PHASE * DECIMATOR_MAX_FACTOR)
+#define DECIMATOR_BLOCK_LEN 256 // Raw ADC samples per DMA half-transfer
+
+void designDecimationFilter(uint8_t factor, float32_t* pCoeffs, uint16_t numTaps);
+void initDecimator(uint8_t factor);
+uint16_t decimateAdcBlock(const uint16_t* pSrc, uint16_t* pDst);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+#include "spectrum.h"
+
+typedef enum
+{
+    FUNDAMENTAL_STRONGEST_BIN,
+    FUNDAMENTAL_HARMONIC_PRODUCT,
+    FUNDAMENTAL_SUBHARMONIC_SUM,
+    FUNDAMENTAL_ESTIMATOR_COUNT,
+} FundamentalEstimator;
+
+extern FundamentalEstimator FUNDAMENTAL_ESTIMATOR; // Default is FUNDAMENTAL_SUBHARMONIC_SUM with HARMONIC_SUMMATION
+extern const uint8_t HARMONIC_PRODUCT_HARMONICS; // Spectra multiplied by the HPS, limits f0 to the band top / this
+extern const uint8_t SUBHARMONIC_SUM_HARMONICS; // Harmonics summed per candidate
+extern const float32_t SUBHARMONIC_SUM_DECAY; // Weight ratio between successive harmonics
+
+uint32_t findFundamentalBin(const float32_t* pBandMag, const SpectrumBand* pBand);
+uint32_t findFundamentalBinQ15(const q15_t* pBandMag, const SpectrumBand* pBand);
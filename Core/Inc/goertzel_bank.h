@@ -0,0 +1,24 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GOERTZEL_BANK_SIZE 21 // Filters spread evenly over +-GOERTZEL_BANK_SPAN_CENTS
+
+typedef struct
+{
+    float32_t targetFrequency; // Hz, centre of the bank
+    float32_t frequency; // Hz, interpolated peak
+    float32_t centsDeviation; // Peak relative to the target
+    float32_t magnitude; // Peak |X| of the windowed frame
+    bool isInRange; // False when the peak is at an edge filter, the tone may lie outside the bank
+} GoertzelResult;
+
+extern float32_t GOERTZEL_BANK_SPAN_CENTS; // Half-width of the bank, 100 cents is one semitone either side
+
+void startGoertzelBank(float32_t targetFrequency, uint16_t frameLength);
+void stopGoertzelBank();
+void restartGoertzelFrame();
+void updateGoertzelBank(const uint16_t* pChunk, uint16_t length);
+bool takeGoertzelResult(GoertzelResult* pResult);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "string_tuning.h"
+
+typedef struct
+{
+    float32_t f0; // Hz, frequency of the harmonic series the partials are stretched from
+    float32_t b; // Inharmonicity coefficient, partial h at h * f0 * sqrt(1 + b * h^2)
+    float32_t residualCents; // Weighted RMS distance of the partials to the fit, the fit quality
+    uint8_t partialCount; // Partials in the fit
+    bool fixedB; // b is the one stored for the string, too few partials to fit it
+} InharmonicFit;
+
+typedef struct
+{
+    float32_t b; // Smoothed inharmonicity coefficient of the string
+    uint16_t fitCount; // Fits accepted for the string, 0 while b is unknown
+} StringInharmonicity;
+
+extern bool INHARMONIC_FIT; // Replace the fundamental peak with f0 of the fit of all tracked partials
+extern uint8_t INHARMONIC_MIN_PARTIALS; // Partials needed to fit b, fewer reuse the stored b of the string
+extern float32_t INHARMONIC_MAX_B; // Largest plausible b, larger fits are clamped
+extern float32_t INHARMONIC_MAX_RESIDUAL_CENTS; // Worst fit quality accepted
+extern float32_t INHARMONIC_B_SMOOTHING; // Weight of a new fit in the stored b of the string
+extern float32_t INHARMONIC_STRING_CENTS; // Largest distance of a note to an open string to share its b
+extern float32_t INHARMONIC_FUNDAMENTAL_WEIGHT; // Extra weight of the refined fundamental over the harmonics
+extern StringInharmonicity INHARMONIC_STRINGS[GUIDED_STRING_COUNT]; // Indexed by GuidedString
+
+void resetInharmonicity();
+GuidedString findInharmonicString(float32_t frequency);
+float32_t getStringInharmonicity(float32_t frequency);
+float32_t predictPartialFrequency(float32_t fundamentalFreq, uint8_t harmonic, float32_t b);
+bool fitInharmonicity(InharmonicFit* pFit);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+#include "signal_gate.h"
+
+extern float32_t INPUT_SWITCH_MARGIN; // SNR ratio another input needs over the current one to take over
+
+void resetInputSelector();
+uint8_t selectAudioInput(const uint16_t* pHistory, uint32_t startSample, uint16_t length, SignalGateStats* pStats);
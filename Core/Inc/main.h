@@ -59,6 +59,7 @@ void MxAdcInit(void);
 void MxDmaInit(void);
 void MxUartInit(void);
 void MxI2cInit(void);
+void MxTimInit(void);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
@@ -73,6 +74,8 @@ void MxI2cInit(void);
 #define ADC_INPUT_GPIO_Port GPIOA
 
 /* USER CODE BEGIN Private defines */
+#define ADC_INPUT2_Pin GPIO_PIN_5 // Second input (ADC1_IN5), scanned with DUAL_INPUT
+#define ADC_INPUT2_GPIO_Port GPIOA
 
 /* USER CODE END Private defines */
 
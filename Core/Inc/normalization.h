@@ -0,0 +1,15 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "window.h"
+
+extern float32_t DC_BLOCKER_CUTOFF_FREQ; // -3 dB corner of the DC-blocking high-pass in Hz
+
+void resetDcBlocker();
+void normalize(const uint16_t* pAudioHistory, uint32_t startSample, float32_t* dst, size_t len);
+void normalizeWithWindow(const uint16_t* pAudioHistory, uint32_t startSample, float32_t* dst, size_t len,
+                         WindowType window);
+uint8_t normalizeQ15(const uint16_t* pAudioHistory, uint32_t startSample, q15_t* dst, size_t len);
+void normalizeBlockMean(const uint16_t* pAudioHistory, uint32_t startSample, float32_t* dst, size_t len);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+extern float32_t ONSET_ENERGY_RATIO; // Chunk energy / background energy that counts as an onset
+extern float32_t ONSET_MIN_RMS; // Quieter chunks never trigger, relative to full scale
+extern uint16_t ONSET_HOLDOFF_MS; // Minimum time between two onsets
+extern uint16_t ONSET_WINDOW_DELAY_MS; // Analysis blocks start this long after an onset
+
+void resetOnsetDetector();
+bool detectOnset(const uint16_t* pChunk, uint16_t length);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "adc_data.h"
+#include "spectrum.h"
+
+#define PARTIAL_TRACK_COUNT 8 // Partials followed, the fundamental and its harmonics
+
+typedef struct
+{
+    float32_t frequency; // Hz, from the interpolated peak
+    float32_t amplitude; // Squared magnitude of the peak bin
+    uint16_t age; // Frames the partial has been followed for, 0 when the track is free
+    uint8_t missedFrames; // Consecutive frames without a matching peak
+} PartialTrack;
+
+extern bool PARTIAL_TRACKING; // Use the fundamental track as the prior of calculateStringTuningInfo()
+extern float32_t PARTIAL_MATCH_CENTS; // Largest move of a partial between two frames
+extern uint16_t PARTIAL_MIN_AGE; // Frames before the fundamental track is trusted as the prior
+extern uint8_t PARTIAL_MAX_MISSED; // Frames a harmonic track survives without a peak
+extern float32_t PARTIAL_MIN_RATIO; // Weakest peak followed, relative to the last fundamental power
+extern PartialTrack PARTIAL_TRACKS[PARTIAL_TRACK_COUNT]; // [h - 1] follows harmonic h
+
+void resetPartialTracker();
+void startPartialFrame(const AudioBlock* pBlock);
+bool findTrackedFundamentalBin(const float32_t* pBandMag, const SpectrumBand* pBand, uint32_t* pPeakIdx);
+void updatePartialTracks(const float32_t* pBandMag, const SpectrumBand* pBand, uint32_t fundamentalIdx,
+                         float32_t fundamentalFreq);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+
+typedef enum
+{
+    PEAK_INTERP_NONE,
+    PEAK_INTERP_PARABOLIC,
+    PEAK_INTERP_GAUSSIAN,
+    PEAK_INTERP_JAIN,
+    PEAK_INTERP_COUNT,
+} PeakInterpolation;
+
+typedef struct
+{
+    float32_t bin; // Fractional position, in the bin units of the input array
+    float32_t magnitude; // Estimated peak magnitude |X|, not squared
+} SpectralPeak;
+
+extern PeakInterpolation PEAK_INTERPOLATION; // Estimator used by calculateStringTuningInfo()
+extern const char* const PEAK_INTERPOLATION_NAMES[PEAK_INTERP_COUNT];
+
+SpectralPeak interpolatePeak(const float32_t* pPower, uint16_t count, uint32_t peakIdx, PeakInterpolation method);
+SpectralPeak interpolatePeakQuinn(const float32_t* pFftOutput, uint16_t fftLen, uint16_t peakBin);
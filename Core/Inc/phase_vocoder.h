@@ -0,0 +1,17 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "adc_data.h"
+#include "spectrum.h"
+
+#define PHASE_VOCODER_BINS 5 // Complex bins kept per frame, centred on the last fundamental
+
+extern bool PHASE_VOCODER_REFINEMENT; // Refine the spectrum peak from the phase advance between frames
+extern float32_t PHASE_VOCODER_MAX_CORRECTION; // Largest accepted correction of the magnitude estimate, bins
+
+void resetPhaseVocoder();
+void capturePhaseVocoderFrame(const float32_t* pFftOutput, const SpectrumBand* pBand, const uint16_t* pAudioHistory,
+                              const AudioBlock* pBlock);
+bool refinePhaseVocoder(const SpectrumBand* pBand, uint32_t peakIdx, float32_t* pPeakBin);
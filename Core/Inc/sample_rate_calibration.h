@@ -0,0 +1,17 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SAMPLE_RATE_CALIBRATION_CHUNKS 256 // DMA chunks timed before the rate is updated
+
+extern volatile float32_t MEASURED_SAMPLING_FREQ; // Last measured analysis rate, 0 until measured against the LSE
+extern float32_t CORE_CLOCK_CORRECTION; // True / nominal core clock, 1 without the LSE reference
+
+void measureCoreClockCorrection();
+void startSampleRateCalibration();
+void resetAdcChunkTimingReference();
+void recordAdcChunkTiming(uint16_t chunkLength);
+void applyMeasuredSampleRate();
+bool isSampleRateCalibrated();
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint16_t mean; // Block mean (DC bias) in sample units
+    float32_t rms; // AC RMS of the block relative to full scale (0..1)
+    float32_t peak; // Largest deviation from the block mean relative to full scale (0..1)
+    uint16_t clippedSamples; // Samples at the rails of the converter
+    bool isOpen; // Gate state after this block, with hysteresis
+} SignalGateStats;
+
+extern SignalGateStats SIGNAL_GATE_STATS; // Statistics of the block being analysed, main loop only
+extern float32_t SIGNAL_GATE_OPEN_RMS; // Gate opens at or above this RMS
+extern float32_t SIGNAL_GATE_CLOSE_RMS; // Gate closes below this RMS
+extern uint16_t SIGNAL_GATE_CLIP_MARGIN; // Distance from the rails, in 12-bit converter LSBs, counted as clipped
+
+void calculateSignalStats(const uint16_t* pHistory, uint32_t startSample, uint16_t length, SignalGateStats* pStats);
+void applySignalGate(SignalGateStats* pStats);
+void updateSignalGate(const uint16_t* pHistory, uint32_t startSample, uint16_t length);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "spectrum.h"
+
+#define SLIDING_DFT_MAX_BINS 32 // Bins tracked around the last peak, two of them only feed the Hann kernel
+
+extern uint8_t SLIDING_DFT_REANCHOR_WINDOWS; // Sliding windows between exact recomputations of the bins
+
+void startSlidingDft(const uint16_t* pAudioHistory, uint16_t fftLen, float32_t centerFrequency);
+void stopSlidingDft();
+void updateSlidingDft(uint32_t endSample);
+bool takeSlidingDftMagnitudes(float32_t* pBandMag, SpectrumBand* pBand);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint16_t fftLen; // Real FFT size the bins belong to
+    uint16_t firstBin; // Bin of the first magnitude
+    uint16_t binCount; // Magnitudes in the band
+} SpectrumBand;
+
+extern float32_t SPECTRUM_MIN_FREQ; // Lowest frequency analysed, Hz
+extern float32_t SPECTRUM_MAX_FREQ; // Highest frequency analysed, Hz
+
+SpectrumBand getSpectrumBand(uint16_t fftLen);
+float32_t calculateBinFrequency(const SpectrumBand* pBand, float32_t bandIdx);
+void calculateBandMagnitudes(const float32_t* pFftOutput, const SpectrumBand* pBand, float32_t* pBandMag);
+void calculateBandMagnitudesQ15(const q15_t* pFftOutput, const SpectrumBand* pBand, q15_t* pBandMag);
@@ -1,5 +1,8 @@
 #pragma once
 #include <arm_math.h>
+#include <stdbool.h>
+#include "goertzel_bank.h"
+#include "spectrum.h"
 
 typedef enum
 {
@@ -9,6 +12,30 @@ typedef enum
     UNKNOWN,
 } StringTension;
 
+typedef enum
+{
+    GUIDED_STRING_NONE,
+    GUIDED_STRING_E2,
+    GUIDED_STRING_A2,
+    GUIDED_STRING_D3,
+    GUIDED_STRING_G3,
+    GUIDED_STRING_B3,
+    GUIDED_STRING_E4,
+    GUIDED_STRING_COUNT,
+} GuidedString;
+
+typedef struct
+{
+    float32_t frequency; // Hz, shown and named: the fitted f0 when the fit is accepted, otherwise peakFrequency
+    float32_t peakFrequency; // Hz, fundamental peak after the zoom and phase vocoder refinement
+    float32_t residualCents; // Weighted RMS distance of the partials to the fit, 0 without one
+    uint8_t partialCount; // Partials in the fit, 0 without one
+    bool isFitted; // frequency is the f0 of an accepted inharmonicity fit
+} TuningEstimate;
+
+extern GuidedString GUIDED_STRING; // String tuned with the Goertzel bank, or GUIDED_STRING_NONE for the full analysis
+extern const float32_t GUIDED_STRING_FREQS[GUIDED_STRING_COUNT];
+
 void detectNote(float32_t frequency);
 float32_t calculateNoteNumber(float32_t frequency);
 uint8_t calculateRoundedNoteNumber(float32_t noteNumber);
@@ -16,4 +43,9 @@ uint8_t calculateNoteIndex(uint8_t roundedNoteNumber);
 uint8_t calculateNoteOctave(uint8_t roundedNoteNumber);
 float32_t calculateFreqFromFftIndex(uint16_t size, float32_t sampling_freq, uint16_t idx);
 float32_t findDominantFrequency(const float32_t* pFftMag, uint16_t size);
-void calculateStringTuningInfo(const float32_t* pFftMag, uint16_t size);
+TuningEstimate calculateStringTuningInfo(const float32_t* pBandMag, const SpectrumBand* pBand);
+float32_t calculateStringTuningInfoQ15(const q15_t* pBandMag, const SpectrumBand* pBand);
+float32_t calculateStringTuningInfoTimeDomain(const arm_rfft_fast_instance_f32* pFftInstance, float32_t* pSamples,
+                                              float32_t* pWork, uint16_t len);
+float32_t calculateStringTuningInfoGuided(const GoertzelResult* pResult);
+float32_t calculateStringTuningInfoSliding(const float32_t* pBandMag, const SpectrumBand* pBand);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+
+#define PITCH_MAX_LAG 512 // Longest period searched, in samples: 15.6 Hz at 8 kHz
+
+typedef enum
+{
+    PITCH_DETECTOR_SPECTRUM,
+    PITCH_DETECTOR_YIN,
+    PITCH_DETECTOR_MCLEOD,
+    PITCH_DETECTOR_CEPSTRUM,
+    PITCH_DETECTOR_COUNT,
+} PitchDetector;
+
+extern PitchDetector PITCH_DETECTOR; // Selects the path in the tuner loop
+extern const char* const PITCH_DETECTOR_NAMES[PITCH_DETECTOR_COUNT];
+extern float32_t YIN_THRESHOLD; // Absolute threshold on the cumulative mean normalised difference
+extern float32_t MCLEOD_PEAK_RATIO; // First NSDF key maximum above this fraction of the highest wins
+extern float32_t CEPSTRUM_POWER_FLOOR; // Power floor before the log, relative to the strongest bin
+
+float32_t estimateTimeDomainPitch(const arm_rfft_fast_instance_f32* pFftInstance, PitchDetector detector,
+                                  float32_t* pSamples, float32_t* pWork, uint16_t len);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+
+typedef enum
+{
+    WINDOW_RECTANGULAR,
+    WINDOW_HANN,
+    WINDOW_BLACKMAN_HARRIS,
+    WINDOW_FLAT_TOP,
+    WINDOW_TYPE_COUNT,
+} WindowType;
+
+extern WindowType ANALYSIS_WINDOW; // Window applied by normalize() and normalizeQ15()
+
+const float32_t* getWindowTable(WindowType type, uint16_t length);
+const q15_t* getWindowTableQ15(WindowType type, uint16_t length);
+
+/*
+ * Tables hold entries 0..length / 2 of a symmetric window, w[length - i] == w[i].
+ */
+static inline size_t getWindowTableIdx(const size_t sampleIdx, const size_t length)
+{
+    return sampleIdx <= length / 2 ? sampleIdx : length - sampleIdx;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <arm_math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "adc_data.h"
+#include "spectrum.h"
+
+#define ZOOM_DECIMATION 16 // Decimation after the heterodyne, the zoom band is ADC_SAMPLING_FREQ / ZOOM_DECIMATION wide
+#define ZOOM_POINTS 64 // Frequencies evaluated across the zoom span
+
+extern bool ZOOM_REFINEMENT; // Refine the spectrum peak with a zoom transform of the block
+extern float32_t ZOOM_HALF_SPAN_BINS; // Zoom span on each side of the coarse peak, in bins of the coarse spectrum
+
+void resetZoomFft();
+void captureZoomBlock(const uint16_t* pAudioHistory, const AudioBlock* pBlock);
+bool refineZoomFft(const SpectrumBand* pBand, float32_t* pPeakBin);
+float32_t zoomPeakFrequency(const uint16_t* pAudioHistory, uint32_t startSample, uint16_t length, uint16_t bias,
+                            float32_t centerFreq, float32_t halfSpan);
@@ -2,26 +2,202 @@
 #include <main.h>
 #include <stdbool.h>
 #include "uart_log.h"
+#include "sample_rate_calibration.h"
+#include "signal_gate.h"
+#include "onset_detector.h"
+#include "input_selector.h"
+#include "goertzel_bank.h"
+#include "sliding_dft.h"
+#include "decimation_pyramid.h"
+#include <string.h>
 
+const uint32_t ADC_SAMPLE_RATE_TABLE[ADC_RATE_COUNT] = {4000, 8000, 16000, 32000};
 const uint16_t AUDIO_DATA_LEN = 2048;
-const float32_t ADC_SAMPLING_FREQ = 8130.0f;
-const float32_t ADC_SAMPLING_RATE = 1.0f / 8130.0f;
+#ifdef ADC_OVERSAMPLING
+const uint8_t AUDIO_SAMPLE_BITS = 16;
+#else
+const uint8_t AUDIO_SAMPLE_BITS = 12;
+#endif // ADC_OVERSAMPLING
+float32_t ADC_SAMPLING_FREQ = 8000.0f;
 volatile bool AUDIO_DATA_IS_ACTUAL = false;
+volatile uint32_t ADC_SAMPLE_COUNTER = 0;
+volatile uint32_t ADC_DROPPED_BLOCKS = 0;
+uint16_t ADC_WAKE_THRESHOLD = 48;
+
+static const uint32_t ADC_IDLE_SAMPLE_FREQ = 1000;
+static const uint16_t ADC_MAX_VALUE = 4095;
+static volatile bool adcWatchdogTriggered = false;
 
 extern ADC_HandleTypeDef hadc1;
+extern TIM_HandleTypeDef htim2;
+
+/*
+ * The DMA runs in circular mode over a small private ring of two raw chunks. Every
+ * half-transfer interrupt appends one chunk to the caller's history ring (decimated first
+ * with ADC_OVERSAMPLING) and runs the onset detector on it. Analysis blocks are windows of
+ * the history: a block is published as soon as its last sample has arrived, and the next
+ * one follows it back to back. setAdcBlockLength() changes the length of the block in
+ * progress, so its start stays put and only its end moves. An onset drops the block in progress and restarts the
+ * sequence ONSET_WINDOW_DELAY_MS after the onset, so no block contains the pick attack.
+ * A published block must be read (or copied out) before it is AUDIO_HISTORY_LEN samples old.
+ *
+ * In guided tuning the Goertzel bank is fed from here as well, chunk by chunk, and so are
+ * the sliding DFT with SLIDING_DFT and the decimation pyramid with DECIMATION_PYRAMID.
+ *
+ * With DUAL_INPUT every trigger converts both inputs, so the raw ring and the history hold
+ * interleaved frames. The onset detector follows the input selected for the last block.
+ */
+static uint16_t pAdcRawRing[2 * ADC_RAW_CHUNK_LEN * AUDIO_INPUT_COUNT];
+static uint16_t* pAudioHistory = NULL;
+static volatile uint16_t adcBlockLen = 0;
+static uint32_t nextBlockStart = 0;
+static uint32_t lastOnsetSample = 0;
+static bool hasOnset = false;
+static uint8_t selectedInput = 0;
+static volatile AudioBlock readyBlock = {0};
+
+static void publishAdcBlock(const uint32_t startSample)
+{
+    if (AUDIO_DATA_IS_ACTUAL)
+    {
+        ADC_DROPPED_BLOCKS++;
+    }
+    SignalGateStats stats = {0};
+    #ifdef DUAL_INPUT
+    selectedInput = selectAudioInput(pAudioHistory, startSample, adcBlockLen, &stats);
+    #else
+    calculateSignalStats(pAudioHistory, startSample, adcBlockLen, &stats);
+    #endif // DUAL_INPUT
+    applySignalGate(&stats);
+    readyBlock.startSample = startSample;
+    readyBlock.length = adcBlockLen;
+    readyBlock.samplesSinceOnset = hasOnset ? startSample - lastOnsetSample : AUDIO_NO_ONSET;
+    readyBlock.input = selectedInput;
+    readyBlock.gate = stats;
+    AUDIO_DATA_IS_ACTUAL = true;
+}
+
+static void processAdcChunk(const uint16_t* pRawChunk)
+{
+    const uint32_t chunkStart = ADC_SAMPLE_COUNTER;
+    uint16_t* pChunk = pAudioHistory + ((chunkStart * AUDIO_INPUT_COUNT) & (AUDIO_HISTORY_LEN * AUDIO_INPUT_COUNT - 1));
+    #ifdef ADC_OVERSAMPLING
+    decimateAdcBlock(pRawChunk, pChunk);
+    #else
+    memcpy(pChunk, pRawChunk, ADC_CHUNK_LEN * AUDIO_INPUT_COUNT * sizeof(uint16_t));
+    #endif // ADC_OVERSAMPLING
+    ADC_SAMPLE_COUNTER = chunkStart + ADC_CHUNK_LEN;
+    recordAdcChunkTiming(ADC_CHUNK_LEN);
+    updateGoertzelBank(pChunk + selectedInput, ADC_CHUNK_LEN);
+    #ifdef SLIDING_DFT
+    updateSlidingDft(ADC_SAMPLE_COUNTER);
+    #endif // SLIDING_DFT
+    #ifdef DECIMATION_PYRAMID
+    updateDecimationPyramid(pChunk + selectedInput, chunkStart);
+    #endif // DECIMATION_PYRAMID
+
+    if (detectOnset(pChunk + selectedInput, ADC_CHUNK_LEN))
+    {
+        const uint32_t delaySamples = (uint32_t)(ADC_SAMPLING_FREQ * (float32_t)ONSET_WINDOW_DELAY_MS / 1000.0f);
+        lastOnsetSample = chunkStart;
+        hasOnset = true;
+        nextBlockStart = chunkStart + delaySamples;
+        restartGoertzelFrame();
+    }
+
+    const int32_t samplesPastBlockEnd = (int32_t)(ADC_SAMPLE_COUNTER - (nextBlockStart + adcBlockLen));
+    if (samplesPastBlockEnd >= 0)
+    {
+        if (samplesPastBlockEnd >= ADC_CHUNK_LEN)
+        {
+            // The block was shortened after its end had passed: take the newest samples instead
+            nextBlockStart = ADC_SAMPLE_COUNTER - adcBlockLen;
+        }
+        publishAdcBlock(nextBlockStart);
+        nextBlockStart += adcBlockLen;
+    }
+}
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc)
+{
+    if (hadc->Instance == ADC1)
+    {
+        processAdcChunk(pAdcRawRing);
+    }
+}
 
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc)
 {
     if (hadc->Instance == ADC1)
     {
-        AUDIO_DATA_IS_ACTUAL = true;
+        processAdcChunk(pAdcRawRing + ADC_RAW_CHUNK_LEN * AUDIO_INPUT_COUNT);
     }
 }
 
-void startAdcDataRecording(uint16_t* pData, const uint16_t length)
+/*
+ * Timers on APB1 run at PCLK1 when the APB1 prescaler is 1 and at 2 * PCLK1 otherwise.
+ */
+static uint32_t getTim2ClockFreq()
+{
+    const uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    return (RCC->CFGR & RCC_CFGR_PPRE1) == RCC_HCLK_DIV1 ? pclk1 : 2 * pclk1;
+}
+
+/*
+ * Every conversion is triggered by the TIM2 update event (TRGO), so the sample rate is
+ * TIM2 clock / period. The period is rounded to the nearest tick and the rate the timer
+ * actually produces, divided by the decimation factor, is published in ADC_SAMPLING_FREQ
+ * for the pitch math.
+ */
+void setAdcSampleRate(const AdcSampleRateMode mode)
+{
+    const uint32_t requestedFreq = ADC_SAMPLE_RATE_TABLE[mode];
+    const uint32_t timerFreq = getTim2ClockFreq();
+    const uint32_t period = (timerFreq + requestedFreq / 2) / requestedFreq;
+
+    __HAL_TIM_SET_PRESCALER(&htim2, 0);
+    __HAL_TIM_SET_AUTORELOAD(&htim2, period - 1);
+    __HAL_TIM_SET_COUNTER(&htim2, 0);
+
+    ADC_SAMPLING_FREQ = (float32_t)timerFreq / (float32_t)period / (float32_t)ADC_DECIMATION_FACTOR;
+    startSampleRateCalibration();
+
+    #ifdef UART_LOG
+    uartPrintf("Sample rate: requested %lu Hz, actual %.3f Hz\n\r", requestedFreq, ADC_SAMPLING_FREQ);
+    #endif // UART_LOG
+}
+
+void startAdcRingRecording(uint16_t* pHistory, const uint16_t blockLength)
 {
+    pAudioHistory = pHistory;
+    adcBlockLen = blockLength;
+    nextBlockStart = 0;
+    hasOnset = false;
+    ADC_SAMPLE_COUNTER = 0;
+    ADC_DROPPED_BLOCKS = 0;
+    AUDIO_DATA_IS_ACTUAL = false;
+    resetAdcChunkTimingReference();
+    resetOnsetDetector();
+    #ifdef ADC_OVERSAMPLING
+    initDecimator(ADC_DECIMATION_FACTOR);
+    #endif // ADC_OVERSAMPLING
+    #ifdef DECIMATION_PYRAMID
+    resetDecimationPyramid();
+    #endif // DECIMATION_PYRAMID
+    HAL_ADC_Start_DMA(&hadc1, (uint32_t*)pAdcRawRing, 2 * ADC_RAW_CHUNK_LEN * AUDIO_INPUT_COUNT);
+    HAL_TIM_Base_Start(&htim2);
+}
+
+void setAdcBlockLength(const uint16_t blockLength)
+{
+    adcBlockLen = blockLength;
+}
+
+void stopAdcRingRecording()
+{
+    HAL_TIM_Base_Stop(&htim2);
+    HAL_ADC_Stop_DMA(&hadc1);
     AUDIO_DATA_IS_ACTUAL = false;
-    HAL_ADC_Start_DMA(&hadc1, (uint32_t*)pData, length);
 }
 
 
@@ -33,7 +209,69 @@ void HAL_ADC_ErrorCallback(ADC_HandleTypeDef* hadc)
 }
 #endif // UART_DEBUG
 
-void waitForAdcData()
+void HAL_ADC_LevelOutOfWindowCallback(ADC_HandleTypeDef* hadc)
+{
+    if (hadc->Instance == ADC1)
+    {
+        __HAL_ADC_DISABLE_IT(hadc, ADC_IT_AWD);
+        adcWatchdogTriggered = true;
+    }
+}
+
+/*
+ * Idle mode between notes. The ADC keeps converting at ADC_IDLE_SAMPLE_FREQ without DMA,
+ * and only the analog watchdog interrupt is enabled, with a window of ADC_WAKE_THRESHOLD
+ * around adcBias (12-bit). The core sleeps until a conversion leaves the window, then the
+ * ADC and TIM2 are restored for the ring capture. The ring must be stopped by the caller.
+ *
+ * STOP mode is not usable here: it gates the ADC clock, so the watchdog could not run.
+ */
+void waitForPluck(const uint16_t adcBias)
+{
+    const uint32_t ringPeriod = __HAL_TIM_GET_AUTORELOAD(&htim2);
+    const uint32_t idlePeriod = getTim2ClockFreq() / ADC_IDLE_SAMPLE_FREQ;
+
+    ADC_AnalogWDGConfTypeDef watchdogConfig = {0};
+    #ifdef DUAL_INPUT
+    watchdogConfig.WatchdogMode = ADC_ANALOGWATCHDOG_ALL_REG; // Either input can wake the tuner
+    #else
+    watchdogConfig.WatchdogMode = ADC_ANALOGWATCHDOG_SINGLE_REG;
+    #endif // DUAL_INPUT
+    watchdogConfig.HighThreshold = adcBias + ADC_WAKE_THRESHOLD < ADC_MAX_VALUE ? adcBias + ADC_WAKE_THRESHOLD : ADC_MAX_VALUE;
+    watchdogConfig.LowThreshold = adcBias > ADC_WAKE_THRESHOLD ? adcBias - ADC_WAKE_THRESHOLD : 0;
+    watchdogConfig.Channel = ADC_CHANNEL_4;
+    watchdogConfig.ITMode = ENABLE;
+    HAL_ADC_AnalogWDGConfig(&hadc1, &watchdogConfig);
+
+    // Without DMA and with end-of-sequence EOC selection unread results do not raise overruns
+    CLEAR_BIT(hadc1.Instance->CR2, ADC_CR2_EOCS);
+
+    adcWatchdogTriggered = false;
+    __HAL_TIM_SET_AUTORELOAD(&htim2, idlePeriod - 1);
+    __HAL_TIM_SET_COUNTER(&htim2, 0);
+    HAL_ADC_Start(&hadc1);
+    HAL_TIM_Base_Start(&htim2);
+
+    HAL_SuspendTick();
+    while (!adcWatchdogTriggered)
+    {
+        HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+    }
+    HAL_ResumeTick();
+
+    HAL_TIM_Base_Stop(&htim2);
+    HAL_ADC_Stop(&hadc1);
+    CLEAR_BIT(hadc1.Instance->CR1, ADC_CR1_AWDEN | ADC_CR1_AWDSGL | ADC_CR1_AWDIE);
+    SET_BIT(hadc1.Instance->CR2, ADC_CR2_EOCS);
+    __HAL_TIM_SET_AUTORELOAD(&htim2, ringPeriod);
+    __HAL_TIM_SET_COUNTER(&htim2, 0);
+
+    #ifdef UART_LOG
+    uartPrintf("Pluck detected\n\r");
+    #endif // UART_LOG
+}
+
+AudioBlock waitForAdcBlock()
 {
     HAL_SuspendTick();
     while (!AUDIO_DATA_IS_ACTUAL)
@@ -42,7 +280,18 @@ void waitForAdcData()
     }
     HAL_ResumeTick();
 
+    __disable_irq();
+    const AudioBlock block = readyBlock;
+    AUDIO_DATA_IS_ACTUAL = false;
+    __enable_irq();
+    SIGNAL_GATE_STATS = block.gate;
+    applyMeasuredSampleRate();
+
     #ifdef UART_DEBUG
-    uartPrintf("Audio data is%s actual\n\n\r", AUDIO_DATA_IS_ACTUAL ? "" : " not");
+    uartPrintf("Audio block ready, samples: %lu, dropped blocks: %lu, rate: %.3f Hz%s\n\n\r",
+               ADC_SAMPLE_COUNTER, ADC_DROPPED_BLOCKS, ADC_SAMPLING_FREQ,
+               isSampleRateCalibrated() ? " (measured)" : "");
     #endif // UART_DEBUG
+
+    return block;
 }
@@ -0,0 +1,44 @@
+#include "analysis_length.h"
+#include "adc_data.h"
+
+/*
+ * Adaptive block length. The resolution a block needs is set by how many periods of the
+ * note it holds, so the shortest length that still holds ANALYSIS_MIN_PERIODS periods of
+ * the last estimate is chosen. At 8 kHz with the default 20 periods this gives 512 samples
+ * (64 ms) for E4, 1024 for G3 and B3, 2048 for E2..D3 and 4096 below that. Without an
+ * estimate (first block, after silence, invalid reading) the default length is used.
+ */
+
+const uint16_t ANALYSIS_LEN_TABLE[ANALYSIS_LEN_COUNT] = {512, 1024, 2048, 4096};
+const AnalysisLength ANALYSIS_LEN_DEFAULT = ANALYSIS_LEN_2048;
+float32_t ANALYSIS_MIN_PERIODS = 20.0f;
+
+AnalysisLength chooseAnalysisLength(const float32_t lastFrequency)
+{
+    if (lastFrequency <= 0.0f)
+    {
+        return ANALYSIS_LEN_DEFAULT;
+    }
+
+    for (AnalysisLength mode = ANALYSIS_LEN_512; mode < ANALYSIS_LEN_4096; mode++)
+    {
+        const float32_t periods = lastFrequency * (float32_t)ANALYSIS_LEN_TABLE[mode] / ADC_SAMPLING_FREQ;
+        if (periods >= ANALYSIS_MIN_PERIODS)
+        {
+            return mode;
+        }
+    }
+    return ANALYSIS_LEN_4096;
+}
+
+AnalysisLength findAnalysisLength(const uint16_t length)
+{
+    for (AnalysisLength mode = ANALYSIS_LEN_512; mode < ANALYSIS_LEN_COUNT; mode++)
+    {
+        if (ANALYSIS_LEN_TABLE[mode] == length)
+        {
+            return mode;
+        }
+    }
+    return ANALYSIS_LEN_DEFAULT;
+}
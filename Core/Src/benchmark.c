@@ -0,0 +1,869 @@
+#include "benchmark.h"
+
+#include <string.h>
+#include "arm_math.h"
+#include "adc_data.h"
+#include "cycle_counter.h"
+#include "decimation_pyramid.h"
+#include "decimator.h"
+#include "fundamental_estimator.h"
+#include "goertzel_bank.h"
+#include "inharmonicity.h"
+#include "normalization.h"
+#include "partial_tracker.h"
+#include "peak_interpolation.h"
+#include "phase_vocoder.h"
+#include "signal_gate.h"
+#include "sliding_dft.h"
+#include "spectrum.h"
+#include "string_tuning.h"
+#include "time_domain_pitch.h"
+#include "window.h"
+#include "zoom_fft.h"
+#include "uart_log.h"
+
+/*
+ * On-target cycle measurements of the DSP stages, printed over UART at startup.
+ * Each stage is run once to warm up caches and filter state, then timed with the
+ * DWT cycle counter.
+ */
+
+static const float32_t BENCH_TONE_FREQ = 196.0f; // G3, relative to the capture rate below
+static const float32_t BENCH_CAPTURE_FREQ = 32000.0f;
+
+static float32_t pBenchInputF32[DECIMATOR_BLOCK_LEN];
+static float32_t pBenchOutputF32[DECIMATOR_BLOCK_LEN];
+static q15_t pBenchInputQ15[DECIMATOR_BLOCK_LEN];
+static q15_t pBenchOutputQ15[DECIMATOR_BLOCK_LEN];
+
+static float32_t pBenchCoeffsF32[DECIMATOR_MAX_TAPS];
+static q15_t pBenchCoeffsQ15[DECIMATOR_MAX_TAPS];
+static float32_t pBenchStateF32[DECIMATOR_MAX_TAPS + DECIMATOR_BLOCK_LEN - 1];
+static q15_t pBenchStateQ15[DECIMATOR_MAX_TAPS + DECIMATOR_BLOCK_LEN - 1];
+
+// Buffers of the analysis, lent by runBenchmarks() before the acquisition starts
+static uint16_t* pBenchHistory; // AUDIO_HISTORY_LEN samples per input, the tone on input 0
+static float32_t* pBenchNormalized; // AUDIO_MAX_DATA_LEN samples
+static float32_t* pBenchFftOutput; // AUDIO_MAX_DATA_LEN packed rfft values
+static float32_t* pBenchBandMag; // Band magnitudes, over pBenchNormalized once the rfft has consumed it
+static q15_t* pBenchScratchQ15; // The same memory as pBenchNormalized and pBenchFftOutput, as q15
+
+#define BENCH_TONE_PARTIALS PARTIAL_TRACK_COUNT
+
+typedef struct
+{
+    float32_t frequency; // Hz, of the 1st partial when b is 0
+    float32_t b; // Inharmonicity, partial h at h * frequency * sqrt(1 + b * h^2)
+    float32_t pAmplitudes[BENCH_TONE_PARTIALS]; // Of partials 1.., relative to full scale, each from phase h - 1
+    float32_t noise; // Amplitude of the uniform pseudo-random noise
+} BenchTone;
+
+static float32_t cpuLoadPercent(const uint32_t cycles, const float32_t callsPerSecond)
+{
+    return 100.0f * (float32_t)cycles * callsPerSecond / (float32_t)HAL_RCC_GetHCLKFreq();
+}
+
+/*
+ * Writes length samples of pTone to input 0 of the history, from the absolute position
+ * startSample, wrapping in the ring like the DMA does. The phase follows from startSample,
+ * so consecutive calls continue the same note.
+ */
+static void synthesizeBenchTone(const BenchTone* pTone, const uint32_t startSample, const uint16_t length)
+{
+    const float32_t halfScale = (float32_t)((1UL << AUDIO_SAMPLE_BITS) - 1) / 2.0f;
+    float32_t pPhases[BENCH_TONE_PARTIALS];
+    float32_t pSteps[BENCH_TONE_PARTIALS];
+    uint8_t partialCount = 0;
+    for (uint8_t h = 1; h <= BENCH_TONE_PARTIALS; h++)
+    {
+        const float32_t partialFreq = (float32_t)h * pTone->frequency * sqrtf(1.0f + pTone->b * (float32_t)(h * h));
+        const float32_t cycles = partialFreq * (float32_t)startSample / ADC_SAMPLING_FREQ;
+        pSteps[h - 1] = 2.0f * PI * partialFreq / ADC_SAMPLING_FREQ;
+        pPhases[h - 1] = fmodf(2.0f * PI * (cycles - floorf(cycles)) + (float32_t)(h - 1), 2.0f * PI);
+        partialCount = pTone->pAmplitudes[h - 1] != 0.0f ? h : partialCount;
+    }
+
+    uint32_t noise = 12345 + startSample;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        noise = noise * 1664525UL + 1013904223UL;
+        float32_t tone = pTone->noise * ((float32_t)(noise >> 16) / 32768.0f - 1.0f);
+        for (uint8_t h = 0; h < partialCount; h++)
+        {
+            tone += pTone->pAmplitudes[h] * arm_sin_f32(pPhases[h]);
+            pPhases[h] += pSteps[h];
+            pPhases[h] -= pPhases[h] >= 2.0f * PI ? 2.0f * PI : 0.0f;
+        }
+        const uint32_t historyIdx = (startSample + i) & (AUDIO_HISTORY_LEN - 1);
+        pBenchHistory[historyIdx * AUDIO_INPUT_COUNT] = (uint16_t)(halfScale * (1.0f + tone));
+    }
+}
+
+/*
+ * What fft() does with a block of the history: gate statistics, normalize() with
+ * ANALYSIS_WINDOW into pBenchNormalized, rfft into pBenchFftOutput and the magnitudes of
+ * pBand. The DC blocker carries over between contiguous blocks, callers reset it per note.
+ * Returns the cycles of everything after the gate.
+ */
+static uint32_t analyseBenchBlock(const arm_rfft_fast_instance_f32* pFftInstance, const SpectrumBand* pBand,
+                                  const uint32_t startSample, float32_t* pBandMag)
+{
+    updateSignalGate(pBenchHistory, startSample, pBand->fftLen);
+    const uint32_t start = getCycleCount();
+    normalize(pBenchHistory, startSample, pBenchNormalized, pBand->fftLen);
+    arm_rfft_fast_f32(pFftInstance, pBenchNormalized, pBenchFftOutput, 0);
+    calculateBandMagnitudes(pBenchFftOutput, pBand, pBandMag);
+    return getCycleCount() - start;
+}
+
+static void benchmarkDecimation()
+{
+    for (uint16_t i = 0; i < DECIMATOR_BLOCK_LEN; i++)
+    {
+        pBenchInputF32[i] = 0.5f * arm_sin_f32(2.0f * PI * BENCH_TONE_FREQ * (float32_t)i / BENCH_CAPTURE_FREQ);
+    }
+    arm_float_to_q15(pBenchInputF32, pBenchInputQ15, DECIMATOR_BLOCK_LEN);
+
+    const float32_t blocksPerSecond = BENCH_CAPTURE_FREQ / (float32_t)DECIMATOR_BLOCK_LEN;
+    uartPrintf("Decimation, %u raw samples per block at %.0f Hz:\n\r", DECIMATOR_BLOCK_LEN, BENCH_CAPTURE_FREQ);
+
+    for (uint8_t factor = 2; factor <= DECIMATOR_MAX_FACTOR; factor *= 2)
+    {
+        const uint16_t numTaps = DECIMATOR_TAPS_PER_PHASE * factor;
+        const uint16_t outputLen = DECIMATOR_BLOCK_LEN / factor;
+        designDecimationFilter(factor, pBenchCoeffsF32, numTaps);
+        arm_float_to_q15(pBenchCoeffsF32, pBenchCoeffsQ15, numTaps);
+
+        arm_fir_decimate_instance_f32 instanceF32;
+        arm_fir_decimate_init_f32(&instanceF32, numTaps, factor, pBenchCoeffsF32, pBenchStateF32,
+                                  DECIMATOR_BLOCK_LEN);
+        arm_fir_decimate_f32(&instanceF32, pBenchInputF32, pBenchOutputF32, DECIMATOR_BLOCK_LEN);
+        uint32_t start = getCycleCount();
+        arm_fir_decimate_f32(&instanceF32, pBenchInputF32, pBenchOutputF32, DECIMATOR_BLOCK_LEN);
+        const uint32_t cyclesF32 = getCycleCount() - start;
+
+        arm_fir_decimate_instance_q15 instanceQ15;
+        arm_fir_decimate_init_q15(&instanceQ15, numTaps, factor, pBenchCoeffsQ15, pBenchStateQ15,
+                                  DECIMATOR_BLOCK_LEN);
+        arm_fir_decimate_q15(&instanceQ15, pBenchInputQ15, pBenchOutputQ15, DECIMATOR_BLOCK_LEN);
+        start = getCycleCount();
+        arm_fir_decimate_q15(&instanceQ15, pBenchInputQ15, pBenchOutputQ15, DECIMATOR_BLOCK_LEN);
+        const uint32_t cyclesQ15 = getCycleCount() - start;
+
+        uartPrintf("  M=%u taps=%3u  f32: %6lu cyc (%4lu/out, %5.2f%% CPU)  q15: %6lu cyc (%4lu/out, %5.2f%% CPU)\n\r",
+                   factor, numTaps,
+                   cyclesF32, cyclesF32 / outputLen, cpuLoadPercent(cyclesF32, blocksPerSecond),
+                   cyclesQ15, cyclesQ15 / outputLen, cpuLoadPercent(cyclesQ15, blocksPerSecond));
+    }
+}
+
+static void benchmarkNormalization()
+{
+    const BenchTone tone = {BENCH_TONE_FREQ, 0.0f, {0.5f}, 0.0f};
+    synthesizeBenchTone(&tone, 0, AUDIO_HISTORY_LEN);
+
+    const float32_t blocksPerSecond = ADC_SAMPLING_FREQ / (float32_t)AUDIO_DATA_LEN;
+    uartPrintf("Normalization, %u samples per block at %.0f Hz:\n\r", AUDIO_DATA_LEN, ADC_SAMPLING_FREQ);
+
+    // Start inside the ring so the samples wrap, as they do for most blocks in the tuner
+    const uint32_t startSample = AUDIO_HISTORY_LEN - AUDIO_DATA_LEN / 2;
+
+    normalizeBlockMean(pBenchHistory, startSample, pBenchNormalized, AUDIO_DATA_LEN);
+    uint32_t start = getCycleCount();
+    normalizeBlockMean(pBenchHistory, startSample, pBenchNormalized, AUDIO_DATA_LEN);
+    const uint32_t cyclesBlockMean = getCycleCount() - start;
+
+    const WindowType analysisWindow = ANALYSIS_WINDOW;
+    ANALYSIS_WINDOW = WINDOW_RECTANGULAR;
+    resetDcBlocker();
+    normalize(pBenchHistory, startSample, pBenchNormalized, AUDIO_DATA_LEN);
+    start = getCycleCount();
+    normalize(pBenchHistory, startSample + AUDIO_DATA_LEN, pBenchNormalized, AUDIO_DATA_LEN);
+    const uint32_t cyclesDcBlocker = getCycleCount() - start;
+
+    ANALYSIS_WINDOW = WINDOW_HANN;
+    start = getCycleCount();
+    normalize(pBenchHistory, startSample + 2 * AUDIO_DATA_LEN, pBenchNormalized, AUDIO_DATA_LEN);
+    const uint32_t cyclesWindowed = getCycleCount() - start;
+    ANALYSIS_WINDOW = analysisWindow;
+    resetDcBlocker();
+
+    uartPrintf("  block mean: %6lu cyc (%5.2f%% CPU)  DC blocker: %6lu cyc (%5.2f%% CPU)"
+               "  DC blocker + Hann: %6lu cyc (%5.2f%% CPU)\n\r",
+               cyclesBlockMean, cpuLoadPercent(cyclesBlockMean, blocksPerSecond),
+               cyclesDcBlocker, cpuLoadPercent(cyclesDcBlocker, blocksPerSecond),
+               cyclesWindowed, cpuLoadPercent(cyclesWindowed, blocksPerSecond));
+}
+
+static uint32_t runFloatPipeline(float32_t* pMag)
+{
+    arm_rfft_fast_instance_f32 fftInstance;
+    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    const SpectrumBand fullBand = {AUDIO_DATA_LEN, 0, AUDIO_DATA_LEN / 2}; // As the q15 magnitudes, no Nyquist
+
+    resetDcBlocker();
+    return analyseBenchBlock(&fftInstance, &fullBand, 0, pMag);
+}
+
+static uint32_t runQ15Pipeline(q15_t* pMag)
+{
+    arm_rfft_instance_q15 fftInstance;
+    arm_rfft_init_q15(&fftInstance, AUDIO_DATA_LEN, 0, 1);
+    q15_t* pNormalized = pBenchScratchQ15;
+    q15_t* pFftOutput = pBenchScratchQ15 + AUDIO_MAX_DATA_LEN; // As fftQ15()
+
+    resetDcBlocker();
+    const uint32_t start = getCycleCount();
+    normalizeQ15(pBenchHistory, 0, pNormalized, AUDIO_DATA_LEN);
+    arm_rfft_q15(&fftInstance, pNormalized, pFftOutput);
+    arm_cmplx_mag_squared_q15(pFftOutput, pMag, AUDIO_DATA_LEN / 2);
+    return getCycleCount() - start;
+}
+
+/*
+ * Runs both spectrum pipelines on the same block (A2 with two harmonics and a little
+ * pseudo-random noise) and reports cycles, the peak bin of each, and how far the Q15
+ * magnitudes are from the float ones after matching the peak heights.
+ */
+static void benchmarkFftPipelines()
+{
+    const BenchTone tone = {GUIDED_STRING_FREQS[GUIDED_STRING_A2], 0.0f, {0.2f, 0.1f, 0.05f}, 0.001f};
+    synthesizeBenchTone(&tone, 0, AUDIO_DATA_LEN);
+
+    // Past what either pipeline writes, so the float magnitudes outlive the q15 pipeline
+    float32_t* pMagF32 = pBenchFftOutput + AUDIO_DATA_LEN;
+    q15_t* pMagQ15 = pBenchScratchQ15 + AUDIO_DATA_LEN;
+    const uint32_t cyclesF32 = runFloatPipeline(pMagF32); // Also leaves the gate statistics normalizeQ15() needs
+    const uint32_t cyclesQ15 = runQ15Pipeline(pMagQ15);
+    resetDcBlocker();
+
+    float32_t maxMagF32 = 0.0f;
+    uint32_t maxIdxF32 = 0;
+    arm_max_f32(pMagF32, AUDIO_DATA_LEN / 2, &maxMagF32, &maxIdxF32);
+    q15_t maxMagQ15 = 0;
+    uint32_t maxIdxQ15 = 0;
+    arm_max_q15(pMagQ15, AUDIO_DATA_LEN / 2, &maxMagQ15, &maxIdxQ15);
+
+    const float32_t q15ToF32 = maxMagF32 / (float32_t)maxMagQ15;
+    float32_t signalEnergy = 0.0f;
+    float32_t errorEnergy = 0.0f;
+    for (uint16_t i = 0; i < AUDIO_DATA_LEN / 2; i++)
+    {
+        const float32_t error = pMagF32[i] - q15ToF32 * (float32_t)pMagQ15[i];
+        signalEnergy += pMagF32[i] * pMagF32[i];
+        errorEnergy += error * error;
+    }
+
+    uartPrintf("Spectrum, %u-point rfft + magnitudes at %.0f Hz:\n\r", AUDIO_DATA_LEN, ADC_SAMPLING_FREQ);
+    uartPrintf("  f32: %7lu cyc, peak bin %lu  q15: %7lu cyc, peak bin %lu  q15 vs f32 SNR: %.1f dB\n\r",
+               cyclesF32, maxIdxF32, cyclesQ15, maxIdxQ15, 10.0f * log10f(signalEnergy / errorEnergy));
+}
+
+/*
+ * Frequency error of the sub-bin estimators on the six open strings, with the rectangular
+ * and the Hann window. Quinn's estimator gets the complex spectrum, the others the squared
+ * magnitudes. Cycles are for a single refinement of the last tone.
+ */
+static void benchmarkPeakInterpolation()
+{
+    static const WindowType pWindows[] = {WINDOW_RECTANGULAR, WINDOW_HANN};
+    const uint8_t toneCount = GUIDED_STRING_COUNT - GUIDED_STRING_E2;
+    const uint8_t methodCount = PEAK_INTERP_COUNT + 1; // Last one is Quinn
+    const float32_t binWidth = ADC_SAMPLING_FREQ / (float32_t)AUDIO_DATA_LEN;
+
+    arm_rfft_fast_instance_f32 fftInstance;
+    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    const SpectrumBand band = getSpectrumBand(AUDIO_DATA_LEN);
+    float32_t* pBandMag = pBenchBandMag;
+
+    uartPrintf("Peak interpolation, %u-point rfft at %.0f Hz (%.2f Hz per bin), error in cents:\n\r",
+               AUDIO_DATA_LEN, ADC_SAMPLING_FREQ, binWidth);
+
+    const WindowType analysisWindow = ANALYSIS_WINDOW;
+    for (uint8_t w = 0; w < sizeof(pWindows) / sizeof(pWindows[0]); w++)
+    {
+        float32_t pMeanError[PEAK_INTERP_COUNT + 1] = {0};
+        float32_t pMaxError[PEAK_INTERP_COUNT + 1] = {0};
+        uint32_t pCycles[PEAK_INTERP_COUNT + 1] = {0};
+        ANALYSIS_WINDOW = pWindows[w];
+
+        for (GuidedString string = GUIDED_STRING_E2; string < GUIDED_STRING_COUNT; string++)
+        {
+            const BenchTone tone = {GUIDED_STRING_FREQS[string], 0.0f, {0.3f}, 0.001f};
+            synthesizeBenchTone(&tone, 0, AUDIO_DATA_LEN);
+            resetDcBlocker();
+            analyseBenchBlock(&fftInstance, &band, 0, pBandMag);
+
+            float32_t maxMag = 0.0f;
+            uint32_t maxIdx = 0;
+            arm_max_f32(pBandMag, band.binCount, &maxMag, &maxIdx);
+
+            for (uint8_t m = 0; m < methodCount; m++)
+            {
+                float32_t frequency = 0.0f;
+                const uint32_t start = getCycleCount();
+                if (m < PEAK_INTERP_COUNT)
+                {
+                    const SpectralPeak peak = interpolatePeak(pBandMag, band.binCount, maxIdx, (PeakInterpolation)m);
+                    frequency = calculateBinFrequency(&band, peak.bin);
+                }
+                else
+                {
+                    const uint16_t peakBin = band.firstBin + (uint16_t)maxIdx;
+                    frequency = interpolatePeakQuinn(pBenchFftOutput, AUDIO_DATA_LEN, peakBin).bin * binWidth;
+                }
+                pCycles[m] = getCycleCount() - start;
+
+                const float32_t error = fabsf(1200.0f * log2f(frequency / tone.frequency));
+                pMeanError[m] += error / (float32_t)toneCount;
+                pMaxError[m] = fmaxf(pMaxError[m], error);
+            }
+        }
+
+        uartPrintf("  %s window:\n\r", pWindows[w] == WINDOW_HANN ? "Hann" : "rectangular");
+        for (uint8_t m = 0; m < methodCount; m++)
+        {
+            uartPrintf("    %-9s mean %6.2f  max %6.2f  %4lu cyc\n\r",
+                       m < PEAK_INTERP_COUNT ? PEAK_INTERPOLATION_NAMES[m] : "quinn",
+                       pMeanError[m], pMaxError[m], pCycles[m]);
+        }
+    }
+    ANALYSIS_WINDOW = analysisWindow;
+    resetDcBlocker();
+}
+
+/*
+ * Spectrum peak against the time-domain detectors and the cepstrum on string-like tones whose fundamental is
+ * 15 dB below the 2nd harmonic. The spectrum path uses the configured FUNDAMENTAL_ESTIMATOR
+ * and PEAK_INTERPOLATION. Errors above 50 cents are counted as gross (octave or fifth) and
+ * kept out of the mean. Cycles include normalization and all transforms, for the last tone.
+ */
+static void benchmarkPitchDetectors()
+{
+    const uint8_t toneCount = GUIDED_STRING_COUNT - GUIDED_STRING_E2;
+
+    arm_rfft_fast_instance_f32 fftInstance;
+    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    const SpectrumBand band = getSpectrumBand(AUDIO_DATA_LEN);
+    float32_t* pBandMag = pBenchBandMag;
+
+    uartPrintf("Pitch detectors, %u samples at %.0f Hz, weak fundamental, error in cents:\n\r",
+               AUDIO_DATA_LEN, ADC_SAMPLING_FREQ);
+
+    for (PitchDetector detector = PITCH_DETECTOR_SPECTRUM; detector < PITCH_DETECTOR_COUNT; detector++)
+    {
+        float32_t meanError = 0.0f;
+        float32_t maxError = 0.0f;
+        uint8_t grossErrors = 0;
+        uint32_t cycles = 0;
+
+        for (GuidedString string = GUIDED_STRING_E2; string < GUIDED_STRING_COUNT; string++)
+        {
+            const BenchTone tone = {GUIDED_STRING_FREQS[string], 0.0f, {0.05f, 0.3f, 0.2f, 0.1f}, 0.002f};
+            synthesizeBenchTone(&tone, 0, AUDIO_DATA_LEN);
+            resetDcBlocker();
+
+            float32_t frequency = 0.0f;
+            if (detector == PITCH_DETECTOR_SPECTRUM)
+            {
+                cycles = analyseBenchBlock(&fftInstance, &band, 0, pBandMag);
+                const uint32_t start = getCycleCount();
+                const uint32_t peakIdx = findFundamentalBin(pBandMag, &band);
+                const SpectralPeak peak = interpolatePeak(pBandMag, band.binCount, peakIdx, PEAK_INTERPOLATION);
+                frequency = calculateBinFrequency(&band, peak.bin);
+                cycles += getCycleCount() - start;
+            }
+            else
+            {
+                updateSignalGate(pBenchHistory, 0, AUDIO_DATA_LEN);
+                const uint32_t start = getCycleCount();
+                normalizeWithWindow(pBenchHistory, 0, pBenchNormalized, AUDIO_DATA_LEN, WINDOW_RECTANGULAR);
+                frequency = estimateTimeDomainPitch(&fftInstance, detector, pBenchNormalized, pBenchFftOutput,
+                                                    AUDIO_DATA_LEN);
+                cycles = getCycleCount() - start;
+            }
+
+            const float32_t error = frequency > 0.0f ? fabsf(1200.0f * log2f(frequency / tone.frequency)) : 1200.0f;
+            if (error > 50.0f)
+            {
+                grossErrors++;
+                continue;
+            }
+            meanError += error;
+            maxError = fmaxf(maxError, error);
+        }
+
+        if (grossErrors < toneCount)
+        {
+            meanError /= (float32_t)(toneCount - grossErrors);
+        }
+        uartPrintf("  %-8s mean %6.2f  max %6.2f  gross %u/%u  %7lu cyc (%5.2f%% CPU)\n\r",
+                   PITCH_DETECTOR_NAMES[detector], meanError, maxError, grossErrors, toneCount, cycles,
+                   cpuLoadPercent(cycles, ADC_SAMPLING_FREQ / (float32_t)AUDIO_DATA_LEN));
+    }
+    resetDcBlocker();
+}
+
+/*
+ * Cost of the guided-tuning Goertzel bank as it runs in the ADC interrupt, per chunk and
+ * per frame, next to the state it needs instead of the frame and FFT buffers.
+ */
+static void benchmarkGoertzelBank()
+{
+    const uint16_t frameLen = AUDIO_DATA_LEN;
+    const uint16_t chunksPerFrame = frameLen / ADC_CHUNK_LEN;
+    const BenchTone tone = {83.0f, 0.0f, {0.3f}, 0.0f};
+    synthesizeBenchTone(&tone, 0, frameLen);
+
+    startGoertzelBank(GUIDED_STRING_FREQS[GUIDED_STRING_E2], frameLen);
+    uint32_t chunkCycles = 0;
+    uint32_t frameCycles = 0;
+    for (uint16_t chunk = 0; chunk < chunksPerFrame; chunk++)
+    {
+        const uint32_t start = getCycleCount();
+        updateGoertzelBank(pBenchHistory + chunk * ADC_CHUNK_LEN * AUDIO_INPUT_COUNT, ADC_CHUNK_LEN);
+        const uint32_t cycles = getCycleCount() - start;
+        frameCycles += cycles;
+        if (chunk == 0)
+        {
+            chunkCycles = cycles;
+        }
+    }
+    GoertzelResult result = {0};
+    takeGoertzelResult(&result);
+    stopGoertzelBank();
+
+    uartPrintf("Goertzel bank, %u filters over +-%.0f cents, %u-sample frames at %.0f Hz:\n\r",
+               GOERTZEL_BANK_SIZE, GOERTZEL_BANK_SPAN_CENTS, frameLen, ADC_SAMPLING_FREQ);
+    uartPrintf("  chunk: %6lu cyc  frame: %7lu cyc (%5.2f%% CPU)  state: %u B  83 Hz read as %.2f cents off E2\n\r",
+               chunkCycles, frameCycles, cpuLoadPercent(frameCycles, ADC_SAMPLING_FREQ / (float32_t)frameLen),
+               (unsigned)(3 * GOERTZEL_BANK_SIZE * sizeof(float32_t)), result.centsDeviation);
+}
+
+/*
+ * Sliding DFT cost per ADC chunk, while the first shadow window is accumulated to anchor the
+ * bins and while they only slide, against one rfft of the same length.
+ */
+static void benchmarkSlidingDft()
+{
+    const uint16_t chunksPerWindow = AUDIO_DATA_LEN / ADC_CHUNK_LEN;
+    const BenchTone tone = {GUIDED_STRING_FREQS[GUIDED_STRING_A2], 0.0f, {0.3f}, 0.0f};
+    synthesizeBenchTone(&tone, 0, AUDIO_HISTORY_LEN);
+
+    startSlidingDft(pBenchHistory, AUDIO_DATA_LEN, tone.frequency);
+    uint32_t endSample = AUDIO_DATA_LEN;
+    updateSlidingDft(endSample); // Takes the start position
+    uint32_t anchorCycles = 0;
+    for (uint16_t chunk = 0; chunk < chunksPerWindow; chunk++)
+    {
+        endSample += ADC_CHUNK_LEN;
+        const uint32_t start = getCycleCount();
+        updateSlidingDft(endSample);
+        anchorCycles = getCycleCount() - start;
+    }
+    endSample += ADC_CHUNK_LEN;
+    uint32_t start = getCycleCount();
+    updateSlidingDft(endSample);
+    const uint32_t slideCycles = getCycleCount() - start;
+    stopSlidingDft();
+
+    arm_rfft_fast_instance_f32 fftInstance;
+    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    arm_fill_f32(0.0f, pBenchNormalized, AUDIO_DATA_LEN);
+    start = getCycleCount();
+    arm_rfft_fast_f32(&fftInstance, pBenchNormalized, pBenchFftOutput, 0);
+    const uint32_t fftCycles = getCycleCount() - start;
+
+    const float32_t chunksPerSecond = ADC_SAMPLING_FREQ / (float32_t)ADC_CHUNK_LEN;
+    uartPrintf("Sliding DFT, %u bins of a %u-point window, %u-sample chunks at %.0f Hz:\n\r",
+               SLIDING_DFT_MAX_BINS, AUDIO_DATA_LEN, ADC_CHUNK_LEN, ADC_SAMPLING_FREQ);
+    uartPrintf("  slide: %6lu cyc (%5.2f%% CPU)  anchor: %6lu cyc (%5.2f%% CPU)  rfft: %7lu cyc (%5.2f%% CPU per chunk)\n\r",
+               slideCycles, cpuLoadPercent(slideCycles, chunksPerSecond),
+               anchorCycles, cpuLoadPercent(anchorCycles, chunksPerSecond),
+               fftCycles, cpuLoadPercent(fftCycles, chunksPerSecond));
+}
+
+/*
+ * Magnitude interpolation against the phase vocoder on three back-to-back blocks of slightly
+ * detuned open strings; the phase estimate is available from the third block. Cycles are
+ * for capturing the bins and refining the peak of the last block.
+ */
+static void benchmarkPhaseVocoder()
+{
+    const uint8_t toneCount = GUIDED_STRING_COUNT - GUIDED_STRING_E2;
+    const uint8_t frameCount = 3;
+
+    arm_rfft_fast_instance_f32 fftInstance;
+    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    const SpectrumBand band = getSpectrumBand(AUDIO_DATA_LEN);
+    float32_t* pBandMag = pBenchBandMag;
+
+    float32_t magnitudeError = 0.0f;
+    float32_t phaseError = 0.0f;
+    uint8_t refinedTones = 0;
+    uint32_t cycles = 0;
+    for (GuidedString string = GUIDED_STRING_E2; string < GUIDED_STRING_COUNT; string++)
+    {
+        const float32_t frequency = GUIDED_STRING_FREQS[string] * 1.003f; // 5 cents sharp, off the bin grid
+        const BenchTone tone = {frequency, 0.0f, {0.3f}, 0.0f};
+        resetDcBlocker();
+        resetPhaseVocoder();
+
+        for (uint8_t frame = 0; frame < frameCount; frame++)
+        {
+            const AudioBlock block = {frame * AUDIO_DATA_LEN, AUDIO_DATA_LEN, AUDIO_NO_ONSET, 0, {0}};
+            synthesizeBenchTone(&tone, block.startSample, AUDIO_DATA_LEN);
+            analyseBenchBlock(&fftInstance, &band, block.startSample, pBandMag);
+
+            const uint32_t start = getCycleCount();
+            capturePhaseVocoderFrame(pBenchFftOutput, &band, pBenchHistory, &block);
+            const uint32_t peakIdx = findFundamentalBin(pBandMag, &band);
+            const SpectralPeak peak = interpolatePeak(pBandMag, band.binCount, peakIdx, PEAK_INTERPOLATION);
+            float32_t peakBin = peak.bin;
+            const bool isRefined = refinePhaseVocoder(&band, peakIdx, &peakBin);
+            cycles = getCycleCount() - start;
+
+            if (frame + 1 == frameCount)
+            {
+                magnitudeError += fabsf(1200.0f * log2f(calculateBinFrequency(&band, peak.bin) / frequency));
+                phaseError += fabsf(1200.0f * log2f(calculateBinFrequency(&band, peakBin) / frequency));
+                refinedTones += isRefined ? 1 : 0;
+            }
+        }
+    }
+    resetPhaseVocoder();
+    resetDcBlocker();
+
+    uartPrintf("Phase vocoder, %u-sample hop at %.0f Hz, mean error in cents:\n\r", AUDIO_DATA_LEN, ADC_SAMPLING_FREQ);
+    uartPrintf("  %s: %.3f  phase: %.4f (%u/%u refined)  fundamental + refinement: %lu cyc\n\r",
+               PEAK_INTERPOLATION_NAMES[PEAK_INTERPOLATION], magnitudeError / (float32_t)toneCount,
+               phaseError / (float32_t)toneCount, refinedTones, toneCount, cycles);
+}
+
+/*
+ * Magnitude interpolation against the zoom transform on detuned open strings with a strong
+ * 2nd harmonic. The zoom starts from the interpolated peak, as in calculateStringTuningInfo().
+ * Cycles are for the zoom of the last tone.
+ */
+static void benchmarkZoomFft()
+{
+    const uint8_t toneCount = GUIDED_STRING_COUNT - GUIDED_STRING_E2;
+
+    arm_rfft_fast_instance_f32 fftInstance;
+    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    const SpectrumBand band = getSpectrumBand(AUDIO_DATA_LEN);
+    float32_t* pBandMag = pBenchBandMag;
+
+    float32_t magnitudeError = 0.0f;
+    float32_t zoomError = 0.0f;
+    uint8_t refinedTones = 0;
+    uint32_t cycles = 0;
+    for (GuidedString string = GUIDED_STRING_E2; string < GUIDED_STRING_COUNT; string++)
+    {
+        const float32_t frequency = GUIDED_STRING_FREQS[string] * 1.003f; // 5 cents sharp, off the bin grid
+        const BenchTone tone = {frequency, 0.0f, {0.15f, 0.2f}, 0.0f};
+        synthesizeBenchTone(&tone, 0, AUDIO_DATA_LEN);
+        resetDcBlocker();
+        analyseBenchBlock(&fftInstance, &band, 0, pBandMag);
+
+        const uint32_t peakIdx = findFundamentalBin(pBandMag, &band);
+        const SpectralPeak peak = interpolatePeak(pBandMag, band.binCount, peakIdx, PEAK_INTERPOLATION);
+        const float32_t coarseFreq = calculateBinFrequency(&band, peak.bin);
+        const float32_t halfSpan = ZOOM_HALF_SPAN_BINS * ADC_SAMPLING_FREQ / (float32_t)AUDIO_DATA_LEN;
+
+        const uint32_t start = getCycleCount();
+        const float32_t zoomFreq = zoomPeakFrequency(pBenchHistory, 0, AUDIO_DATA_LEN, SIGNAL_GATE_STATS.mean,
+                                                     coarseFreq, halfSpan);
+        cycles = getCycleCount() - start;
+
+        magnitudeError += fabsf(1200.0f * log2f(coarseFreq / frequency));
+        if (zoomFreq > 0.0f)
+        {
+            zoomError += fabsf(1200.0f * log2f(zoomFreq / frequency));
+            refinedTones++;
+        }
+    }
+    resetDcBlocker();
+
+    uartPrintf("Zoom FFT, %u samples decimated by %u, %u points over +/- %.1f bins, mean error in cents:\n\r",
+               AUDIO_DATA_LEN, ZOOM_DECIMATION, ZOOM_POINTS, ZOOM_HALF_SPAN_BINS);
+    uartPrintf("  %s: %.3f  zoom: %.4f (%u/%u refined)  zoom: %lu cyc, %.1f%% CPU at one block per %u samples\n\r",
+               PEAK_INTERPOLATION_NAMES[PEAK_INTERPOLATION], magnitudeError / (float32_t)toneCount,
+               refinedTones > 0 ? zoomError / (float32_t)refinedTones : 0.0f, refinedTones, toneCount, cycles,
+               cpuLoadPercent(cycles, ADC_SAMPLING_FREQ / (float32_t)AUDIO_DATA_LEN), AUDIO_DATA_LEN);
+}
+
+/*
+ * Low notes from the decimation pyramid against the AUDIO_DATA_LEN full-rate block, on
+ * tones with a strong 2nd harmonic. The pyramid is fed chunk by chunk as in the ADC
+ * interrupt. Errors are of the interpolated peak, without zoom or phase vocoder; cycles are
+ * for conversion, rfft and magnitudes of the last tone.
+ */
+static void benchmarkDecimationPyramid()
+{
+    static const float32_t pToneFreqs[] = {30.87f, 41.2f, 61.74f, 73.42f}; // B0, E1, B1, D2
+    const uint8_t toneCount = sizeof(pToneFreqs) / sizeof(pToneFreqs[0]);
+    const uint32_t sampleCount = 2 * AUDIO_HISTORY_LEN; // Enough for the longest block of the deepest level
+
+    arm_rfft_fast_instance_f32 fullInstance;
+    arm_rfft_fast_init_f32(&fullInstance, AUDIO_DATA_LEN);
+    const SpectrumBand fullBand = getSpectrumBand(AUDIO_DATA_LEN);
+    float32_t* pBandMag = pBenchBandMag;
+
+    uartPrintf("Decimation pyramid, %u-tap half-band stages, error in cents:\n\r", PYRAMID_HALF_BAND_TAPS);
+    uint32_t chunkCycles = 0;
+    for (uint8_t t = 0; t < toneCount; t++)
+    {
+        const float32_t frequency = pToneFreqs[t] * 1.003f; // 5 cents sharp, off the bin grid
+        const BenchTone tone = {frequency, 0.0f, {0.15f, 0.2f}, 0.0f};
+        resetDecimationPyramid();
+        for (uint32_t chunkStart = 0; chunkStart < sampleCount; chunkStart += ADC_CHUNK_LEN)
+        {
+            synthesizeBenchTone(&tone, chunkStart, ADC_CHUNK_LEN);
+            const uint16_t* pChunk = pBenchHistory + (chunkStart & (AUDIO_HISTORY_LEN - 1)) * AUDIO_INPUT_COUNT;
+            const uint32_t start = getCycleCount();
+            updateDecimationPyramid(pChunk, chunkStart);
+            chunkCycles = getCycleCount() - start;
+        }
+
+        resetDcBlocker();
+        const uint32_t fullCycles = analyseBenchBlock(&fullInstance, &fullBand, sampleCount - AUDIO_DATA_LEN, pBandMag);
+        const uint32_t fullIdx = findFundamentalBin(pBandMag, &fullBand);
+        const SpectralPeak fullPeak = interpolatePeak(pBandMag, fullBand.binCount, fullIdx, PEAK_INTERPOLATION);
+        const float32_t fullError = 1200.0f * log2f(calculateBinFrequency(&fullBand, fullPeak.bin) / frequency);
+
+        const AudioBlock block = {sampleCount - AUDIO_DATA_LEN, AUDIO_DATA_LEN, AUDIO_NO_ONSET, 0, {0}};
+        const PyramidBlock pyramidBlock = choosePyramidBlock(frequency, &block);
+        if (pyramidBlock.length == 0)
+        {
+            uartPrintf("  %6.2f Hz  full rate %u: %7.2f, no pyramid level\n\r", frequency, AUDIO_DATA_LEN, fullError);
+            continue;
+        }
+        arm_rfft_fast_instance_f32 pyramidInstance;
+        arm_rfft_fast_init_f32(&pyramidInstance, pyramidBlock.length);
+        const SpectrumBand pyramidBand = getPyramidBand(&pyramidBlock);
+        const uint32_t start = getCycleCount();
+        readPyramidBlock(&pyramidBlock, pBenchNormalized, ANALYSIS_WINDOW);
+        arm_rfft_fast_f32(&pyramidInstance, pBenchNormalized, pBenchFftOutput, 0);
+        calculateBandMagnitudes(pBenchFftOutput, &pyramidBand, pBandMag);
+        const uint32_t pyramidCycles = getCycleCount() - start;
+        const uint32_t pyramidIdx = findFundamentalBin(pBandMag, &pyramidBand);
+        const SpectralPeak pyramidPeak = interpolatePeak(pBandMag, pyramidBand.binCount, pyramidIdx,
+                                                         PEAK_INTERPOLATION);
+        const float32_t pyramidFreq = calculateBinFrequency(&pyramidBand, pyramidPeak.bin);
+        const float32_t pyramidError = 1200.0f * log2f(pyramidFreq / frequency);
+
+        uartPrintf("  %6.2f Hz  full rate %u: %7.2f, %6lu cyc  level %u (/%u) %u: %7.2f, %6lu cyc\n\r", frequency,
+                   AUDIO_DATA_LEN, fullError, fullCycles, pyramidBlock.level, 1U << pyramidBlock.level,
+                   pyramidBlock.length, pyramidError, pyramidCycles);
+    }
+    resetDcBlocker();
+    uartPrintf("  pyramid update: %lu cyc per %u-sample chunk, %.2f%% CPU\n\r", chunkCycles, ADC_CHUNK_LEN,
+               cpuLoadPercent(chunkCycles, ADC_SAMPLING_FREQ / (float32_t)ADC_CHUNK_LEN));
+}
+
+/*
+ * Fundamental search of a decaying note, the full band with FUNDAMENTAL_ESTIMATOR against
+ * the prior of the partial tracker. The fundamental starts 12 dB below the 2nd harmonic
+ * and the upper partials fade faster than it, so the strongest partial changes on the way.
+ * Errors above 50 cents are gross; cycles are the mean of the search per frame.
+ */
+static void benchmarkPartialTracker()
+{
+    const uint8_t toneCount = GUIDED_STRING_COUNT - GUIDED_STRING_E2;
+    const uint8_t frameCount = 12;
+
+    arm_rfft_fast_instance_f32 fftInstance;
+    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    const SpectrumBand band = getSpectrumBand(AUDIO_DATA_LEN);
+    float32_t* pBandMag = pBenchBandMag;
+
+    uint16_t fullGross = 0;
+    uint16_t trackedGross = 0;
+    uint16_t trackedFrames = 0;
+    uint32_t fullCycles = 0;
+    uint32_t trackedCycles = 0;
+    for (GuidedString string = GUIDED_STRING_E2; string < GUIDED_STRING_COUNT; string++)
+    {
+        const float32_t frequency = GUIDED_STRING_FREQS[string] * 1.003f; // 5 cents sharp, off the bin grid
+        resetPartialTracker();
+        resetDcBlocker();
+        for (uint8_t frame = 0; frame < frameCount; frame++)
+        {
+            const uint32_t startSample = frame * AUDIO_DATA_LEN;
+            const float32_t time = (float32_t)startSample / ADC_SAMPLING_FREQ;
+            const BenchTone tone = {frequency, 0.0f,
+                                    {0.06f * expf(-1.0f * time), 0.24f * expf(-3.0f * time),
+                                     0.16f * expf(-4.0f * time), 0.1f * expf(-6.0f * time)}, 0.002f};
+            synthesizeBenchTone(&tone, startSample, AUDIO_DATA_LEN);
+            analyseBenchBlock(&fftInstance, &band, startSample, pBandMag);
+
+            uint32_t start = getCycleCount();
+            const uint32_t fullIdx = findFundamentalBin(pBandMag, &band);
+            fullCycles += getCycleCount() - start;
+
+            uint32_t trackedIdx = 0;
+            start = getCycleCount();
+            if (findTrackedFundamentalBin(pBandMag, &band, &trackedIdx))
+            {
+                trackedCycles += getCycleCount() - start;
+                trackedFrames++;
+            }
+            else
+            {
+                trackedIdx = findFundamentalBin(pBandMag, &band);
+            }
+            const SpectralPeak peak = interpolatePeak(pBandMag, band.binCount, trackedIdx, PEAK_INTERPOLATION);
+            const float32_t trackedFreq = calculateBinFrequency(&band, peak.bin);
+            updatePartialTracks(pBandMag, &band, trackedIdx, trackedFreq);
+
+            const float32_t fullFreq = calculateBinFrequency(&band, (float32_t)fullIdx);
+            fullGross += fabsf(1200.0f * log2f(fullFreq / frequency)) > 50.0f;
+            trackedGross += fabsf(1200.0f * log2f(trackedFreq / frequency)) > 50.0f;
+        }
+    }
+    resetPartialTracker();
+    resetDcBlocker();
+
+    const uint16_t totalFrames = toneCount * frameCount;
+    uartPrintf("Partial tracker, %u frames of decaying notes, %u-point rfft:\n\r", totalFrames, AUDIO_DATA_LEN);
+    uartPrintf("  full band search %6lu cyc  gross %u/%u\n\r", fullCycles / totalFrames, fullGross, totalFrames);
+    uartPrintf("  tracked   search %6lu cyc  gross %u/%u  prior used in %u frames\n\r",
+               trackedFrames > 0 ? trackedCycles / trackedFrames : 0, trackedGross, totalFrames, trackedFrames);
+}
+
+/*
+ * Plays a few blocks of pTone through the analysis of calculateStringTuningInfo() and fits
+ * f0 and B with the interpolated fundamental peak, or with isRefined with that peak refined
+ * by the zoom transform and the phase vocoder. Returns the fundamental of the last frame;
+ * pFit and pFitCycles are of its fit.
+ */
+static float32_t runInharmonicNote(const arm_rfft_fast_instance_f32* pFftInstance, const SpectrumBand* pBand,
+                                   const BenchTone* pTone, const bool isRefined, InharmonicFit* pFit,
+                                   uint32_t* pFitCycles)
+{
+    const uint8_t frameCount = 3;
+    float32_t* pBandMag = pBenchBandMag;
+
+    resetInharmonicity();
+    resetPartialTracker();
+    resetPhaseVocoder();
+    resetZoomFft();
+    resetDcBlocker();
+    float32_t fundamentalFreq = 0.0f;
+    for (uint8_t frame = 0; frame < frameCount; frame++)
+    {
+        const AudioBlock block = {frame * AUDIO_DATA_LEN, AUDIO_DATA_LEN, AUDIO_NO_ONSET, 0, {0}};
+        synthesizeBenchTone(pTone, block.startSample, AUDIO_DATA_LEN);
+        analyseBenchBlock(pFftInstance, pBand, block.startSample, pBandMag);
+
+        const uint32_t peakIdx = findFundamentalBin(pBandMag, pBand);
+        float32_t peakBin = interpolatePeak(pBandMag, pBand->binCount, peakIdx, PEAK_INTERPOLATION).bin;
+        if (isRefined)
+        {
+            capturePhaseVocoderFrame(pBenchFftOutput, pBand, pBenchHistory, &block);
+            captureZoomBlock(pBenchHistory, &block);
+            refineZoomFft(pBand, &peakBin);
+            refinePhaseVocoder(pBand, peakIdx, &peakBin);
+        }
+        fundamentalFreq = calculateBinFrequency(pBand, peakBin);
+        updatePartialTracks(pBandMag, pBand, peakIdx, fundamentalFreq);
+
+        memset(pFit, 0, sizeof(*pFit));
+        const uint32_t start = getCycleCount();
+        fitInharmonicity(pFit);
+        *pFitCycles = getCycleCount() - start;
+    }
+    return fundamentalFreq;
+}
+
+/*
+ * Strings with stretched partials, at h * f0 * sqrt(1 + B * h^2). The interpolated and the
+ * refined fundamental peak estimate the first partial, as does the mean of f_h / h over the
+ * tracked partials that a harmonic method sees; their errors are against it. The fit of f0
+ * and B runs once with each peak, the refined one as in calculateStringTuningInfo(); its f0
+ * errors are against the true f0. Errors and fits are of the last of a few frames, cycles
+ * of one fit.
+ */
+static void benchmarkInharmonicity()
+{
+    static const float32_t pToneB[] = {1.5e-4f, 1e-4f, 6e-5f, 3e-5f, 2e-5f, 1.5e-5f}; // Wound to plain strings
+
+    arm_rfft_fast_instance_f32 fftInstance;
+    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    const SpectrumBand band = getSpectrumBand(AUDIO_DATA_LEN);
+
+    uartPrintf("Inharmonicity fit, %u-point rfft, error in cents:\n\r", AUDIO_DATA_LEN);
+    for (GuidedString string = GUIDED_STRING_E2; string < GUIDED_STRING_COUNT; string++)
+    {
+        BenchTone tone = {GUIDED_STRING_FREQS[string], pToneB[string - GUIDED_STRING_E2], {0.0f}, 0.001f};
+        for (uint8_t h = 1; h <= BENCH_TONE_PARTIALS; h++)
+        {
+            tone.pAmplitudes[h - 1] = 0.15f / (float32_t)h;
+        }
+        const float32_t firstPartialFreq = tone.frequency * sqrtf(1.0f + tone.b);
+
+        InharmonicFit peakFit;
+        uint32_t fitCycles = 0;
+        const float32_t peakFreq = runInharmonicNote(&fftInstance, &band, &tone, false, &peakFit, &fitCycles);
+        InharmonicFit refinedFit;
+        const float32_t refinedFreq = runInharmonicNote(&fftInstance, &band, &tone, true, &refinedFit, &fitCycles);
+
+        float32_t harmonicFreq = 0.0f;
+        uint8_t harmonicCount = 0;
+        for (uint8_t h = 1; h <= PARTIAL_TRACK_COUNT; h++)
+        {
+            const PartialTrack* pTrack = &PARTIAL_TRACKS[h - 1];
+            if (pTrack->age > 0 && pTrack->missedFrames == 0)
+            {
+                harmonicFreq += pTrack->frequency / (float32_t)h;
+                harmonicCount++;
+            }
+        }
+        harmonicFreq /= (float32_t)harmonicCount;
+
+        uartPrintf("  %6.2f Hz B %.1e  peak %6.2f  refined %6.2f  harmonic %6.2f  %u partials, %4lu cyc\n\r",
+                   tone.frequency, tone.b, 1200.0f * log2f(peakFreq / firstPartialFreq),
+                   1200.0f * log2f(refinedFreq / firstPartialFreq), 1200.0f * log2f(harmonicFreq / firstPartialFreq),
+                   refinedFit.partialCount, fitCycles);
+        uartPrintf("    fit with peak:    f0 %6.2f, B %.2e, residual %.2f\n\r",
+                   1200.0f * log2f(peakFit.f0 / tone.frequency), peakFit.b, peakFit.residualCents);
+        uartPrintf("    fit with refined: f0 %6.2f, B %.2e, residual %.2f\n\r",
+                   1200.0f * log2f(refinedFit.f0 / tone.frequency), refinedFit.b, refinedFit.residualCents);
+    }
+    resetPartialTracker();
+    resetPhaseVocoder();
+    resetZoomFft();
+    resetInharmonicity();
+    resetDcBlocker();
+}
+
+/*
+ * pAudioHistory is the AUDIO_HISTORY_LEN * AUDIO_INPUT_COUNT history of the tuner and
+ * pScratch its 2 * AUDIO_MAX_DATA_LEN float work buffer, which pScratchQ15 views as q15;
+ * both are overwritten. The benchmarks run on AUDIO_DATA_LEN blocks, at most half of
+ * AUDIO_MAX_DATA_LEN, which leaves room in the scratch for their magnitudes.
+ */
+void runBenchmarks(uint16_t* pAudioHistory, float32_t* pScratch, q15_t* pScratchQ15)
+{
+    pBenchHistory = pAudioHistory;
+    pBenchNormalized = pScratch;
+    pBenchFftOutput = pScratch + AUDIO_MAX_DATA_LEN;
+    pBenchBandMag = pScratch;
+    pBenchScratchQ15 = pScratchQ15;
+    enableCycleCounter();
+    uartPrintf("Benchmarks, HCLK %lu Hz\n\r", HAL_RCC_GetHCLKFreq());
+    benchmarkDecimation();
+    benchmarkNormalization();
+    benchmarkFftPipelines();
+    benchmarkPeakInterpolation();
+    benchmarkPitchDetectors();
+    benchmarkGoertzelBank();
+    benchmarkSlidingDft();
+    benchmarkPhaseVocoder();
+    benchmarkZoomFft();
+    benchmarkDecimationPyramid();
+    benchmarkPartialTracker();
+    benchmarkInharmonicity();
+    uartPrintf("\n\r");
+}
@@ -0,0 +1,192 @@
+#include "decimation_pyramid.h"
+#include "analysis_length.h"
+#include "decimator.h"
+
+/*
+ * Multi-rate analysis of the low notes. Every ADC chunk is decimated by 2 three times in a
+ * row, each stage a PYRAMID_HALF_BAND_TAPS low-pass from designDecimationFilter() run by
+ * arm_fir_decimate_q15, so level k holds the input at ADC_SAMPLING_FREQ / 2^k in a ring of
+ * PYRAMID_LEVEL_LEN q15 samples. The three stages together cost fewer than
+ * PYRAMID_HALF_BAND_TAPS MACs per input sample in the interrupt, and the rings take 12 KB.
+ *
+ * A note is analysed at the deepest level whose band still holds PYRAMID_MIN_HARMONICS of
+ * its harmonics, because there the same number of periods fits in the fewest samples. A
+ * 1024-point block at 1 kHz (level 3 at 8 kHz) holds 32 periods of B0 with 0.98 Hz bins,
+ * finer than the 4096-point full-rate block and at a quarter of its FFT cost.
+ *
+ * A level block ends with the published full-rate block, and reaches back at most to the
+ * onset plus the delay of the filters, so it never holds the previous note. Its spectrum is
+ * described as the first bins of a full-rate transform of length << level, which has the
+ * same bin width, so the peak picking and calculateBinFrequency() work unchanged.
+ *
+ * The pyramid follows the input selected for the last block, like the onset detector.
+ */
+
+float32_t PYRAMID_MIN_HARMONICS = 4.0f;
+
+static const float32_t PYRAMID_SAMPLE_SCALE = 1.0f / 32768.0f; // Full scale of the converter is full scale of q15
+
+static q15_t pPyramidRings[PYRAMID_LEVEL_COUNT][PYRAMID_LEVEL_LEN];
+static q15_t pPyramidInput[ADC_CHUNK_LEN];
+static q15_t pPyramidCoeffs[PYRAMID_HALF_BAND_TAPS];
+static q15_t pPyramidStates[PYRAMID_LEVEL_COUNT][PYRAMID_HALF_BAND_TAPS + ADC_CHUNK_LEN - 1];
+static arm_fir_decimate_instance_q15 pPyramidStages[PYRAMID_LEVEL_COUNT];
+
+void resetDecimationPyramid()
+{
+    float32_t pCoeffs[PYRAMID_HALF_BAND_TAPS];
+    designDecimationFilter(2, pCoeffs, PYRAMID_HALF_BAND_TAPS);
+    arm_float_to_q15(pCoeffs, pPyramidCoeffs, PYRAMID_HALF_BAND_TAPS);
+
+    for (uint8_t stage = 0; stage < PYRAMID_LEVEL_COUNT; stage++)
+    {
+        arm_fir_decimate_init_q15(&pPyramidStages[stage], PYRAMID_HALF_BAND_TAPS, 2, pPyramidCoeffs,
+                                  pPyramidStates[stage], ADC_CHUNK_LEN >> stage);
+    }
+}
+
+static q15_t* getLevelChunk(const uint8_t level, const uint32_t chunkStart)
+{
+    return pPyramidRings[level - 1] + ((chunkStart >> level) & (PYRAMID_LEVEL_LEN - 1));
+}
+
+/*
+ * Called from the ADC interrupt with the ADC_CHUNK_LEN samples of one input starting at
+ * absolute sample chunkStart; pChunk has the AUDIO_INPUT_COUNT stride of the history.
+ * Each stage reads the chunk the one before it has just written to its ring.
+ */
+void updateDecimationPyramid(const uint16_t* pChunk, const uint32_t chunkStart)
+{
+    const int32_t midscale = 1L << (AUDIO_SAMPLE_BITS - 1);
+    const int32_t toQ15 = 1L << (16 - AUDIO_SAMPLE_BITS); // Full scale, as decimateAdcBlock()
+    for (uint16_t i = 0; i < ADC_CHUNK_LEN; i++)
+    {
+        const int32_t centered = (int32_t)pChunk[i * AUDIO_INPUT_COUNT] - midscale;
+        pPyramidInput[i] = (q15_t)(centered * toQ15);
+    }
+
+    const q15_t* pStageInput = pPyramidInput;
+    for (uint8_t level = 1; level <= PYRAMID_LEVEL_COUNT; level++)
+    {
+        q15_t* pStageOutput = getLevelChunk(level, chunkStart);
+        arm_fir_decimate_q15(&pPyramidStages[level - 1], pStageInput, pStageOutput, ADC_CHUNK_LEN >> (level - 1));
+        pStageInput = pStageOutput;
+    }
+}
+
+/*
+ * Upper edge of the band of a level: the -6 dB point of designDecimationFilter(), whose
+ * transition band of 5.5 / taps of the input rate ends at the output Nyquist frequency.
+ */
+static float32_t getLevelBandEdge(const uint8_t level)
+{
+    return (0.5f - 5.5f / (float32_t)PYRAMID_HALF_BAND_TAPS) * ADC_SAMPLING_FREQ / (float32_t)(1UL << level);
+}
+
+/*
+ * Delay of the stages in front of a level, in full-rate samples.
+ */
+static uint32_t getLevelDelay(const uint8_t level)
+{
+    return ((1UL << level) - 1) * (PYRAMID_HALF_BAND_TAPS - 1) / 2;
+}
+
+/*
+ * Deepest level whose band holds PYRAMID_MIN_HARMONICS harmonics of lastFrequency, 0 when
+ * the note needs the full rate or is unknown.
+ */
+uint8_t choosePyramidLevel(const float32_t lastFrequency)
+{
+    if (lastFrequency <= 0.0f)
+    {
+        return 0;
+    }
+
+    for (uint8_t level = PYRAMID_LEVEL_COUNT; level > 0; level--)
+    {
+        if (PYRAMID_MIN_HARMONICS * lastFrequency <= getLevelBandEdge(level))
+        {
+            return level;
+        }
+    }
+    return 0;
+}
+
+/*
+ * The level block that replaces pBlock for a note at lastFrequency: the shortest length of
+ * ANALYSIS_LEN_TABLE that holds ANALYSIS_MIN_PERIODS periods at the rate of the level, or
+ * the longest one the level has since the onset. length is 0 when no level applies.
+ */
+PyramidBlock choosePyramidBlock(const float32_t lastFrequency, const AudioBlock* pBlock)
+{
+    PyramidBlock block = {choosePyramidLevel(lastFrequency), 0, 0};
+    if (block.level == 0)
+    {
+        return block;
+    }
+
+    const uint32_t endSample = pBlock->startSample + pBlock->length;
+    uint32_t span = endSample; // Full-rate samples of the current note up to the end of the block
+    if (pBlock->samplesSinceOnset != AUDIO_NO_ONSET && pBlock->samplesSinceOnset + pBlock->length < span)
+    {
+        span = pBlock->samplesSinceOnset + pBlock->length;
+    }
+    const uint32_t delay = getLevelDelay(block.level);
+    const uint32_t available = span > delay ? (span - delay) >> block.level : 0;
+    const float32_t levelFreq = ADC_SAMPLING_FREQ / (float32_t)(1UL << block.level);
+
+    for (AnalysisLength mode = ANALYSIS_LEN_512; mode < ANALYSIS_LEN_COUNT; mode++)
+    {
+        const uint16_t length = ANALYSIS_LEN_TABLE[mode];
+        if (length > PYRAMID_MAX_BLOCK_LEN || length > available)
+        {
+            break;
+        }
+        block.length = length;
+        if (lastFrequency * (float32_t)length / levelFreq >= ANALYSIS_MIN_PERIODS)
+        {
+            break;
+        }
+    }
+    block.startSample = (endSample >> block.level) - block.length;
+    return block;
+}
+
+/*
+ * Band of the FFT of a level block, as bins of a full-rate transform with the same bin
+ * width, cut at the band edge of the level.
+ */
+SpectrumBand getPyramidBand(const PyramidBlock* pBlock)
+{
+    SpectrumBand band = getSpectrumBand((uint16_t)(pBlock->length << pBlock->level));
+    const float32_t binWidth = ADC_SAMPLING_FREQ / (float32_t)band.fftLen;
+    const uint16_t edgeBin = (uint16_t)(getLevelBandEdge(pBlock->level) / binWidth);
+    if (band.firstBin + band.binCount > edgeBin + 1)
+    {
+        band.binCount = edgeBin >= band.firstBin ? edgeBin - band.firstBin + 1 : 1;
+    }
+    return band;
+}
+
+/*
+ * Copies a level block to pDst as floats in -1..1 without its mean, weighted with window.
+ */
+void readPyramidBlock(const PyramidBlock* pBlock, float32_t* pDst, const WindowType window)
+{
+    const q15_t* pRing = pPyramidRings[pBlock->level - 1];
+    const float32_t* pWindow = getWindowTable(window, pBlock->length);
+
+    int32_t sum = 0;
+    for (uint16_t i = 0; i < pBlock->length; i++)
+    {
+        sum += pRing[(pBlock->startSample + i) & (PYRAMID_LEVEL_LEN - 1)];
+    }
+    const float32_t mean = (float32_t)sum / (float32_t)pBlock->length;
+
+    for (uint16_t i = 0; i < pBlock->length; i++)
+    {
+        const float32_t sample = ((float32_t)pRing[(pBlock->startSample + i) & (PYRAMID_LEVEL_LEN - 1)] - mean) *
+            PYRAMID_SAMPLE_SCALE;
+        pDst[i] = pWindow != NULL ? sample * pWindow[getWindowTableIdx(i, pBlock->length)] : sample;
+    }
+}
@@ -0,0 +1,79 @@
+#include "decimator.h"
+
+/*
+ * Anti-aliasing decimator for the oversampled acquisition path.
+ *
+ * Raw 12-bit ADC samples are centred and shifted to the full Q15 range, filtered and
+ * decimated by arm_fir_decimate_q15 (a polyphase implementation that only computes the kept
+ * outputs, saturating the overshoot of a full-scale step) and written back as 16-bit offset
+ * binary, so full scale of the converter is full scale of AUDIO_SAMPLE_BITS. The output keeps the extra resolution
+ * gained by averaging, so consumers must treat it as a 16-bit sample, not a 12-bit one.
+ */
+
+static const uint16_t ADC_MIDSCALE = 2048;
+static const uint8_t ADC_TO_Q15_SHIFT = 4; // 12-bit -> full Q15 scale, -32768..32752
+static const uint16_t Q15_OFFSET = 0x8000;
+
+static q15_t pDecimatorCoeffs[DECIMATOR_MAX_TAPS];
+static q15_t pDecimatorState[DECIMATOR_MAX_TAPS + DECIMATOR_BLOCK_LEN - 1];
+static q15_t pDecimatorInput[DECIMATOR_BLOCK_LEN];
+static arm_fir_decimate_instance_q15 decimatorInstance;
+
+/*
+ * Blackman-windowed sinc low-pass with unity DC gain. The -6 dB point is placed so that
+ * the window's transition band ends at the output Nyquist frequency (fs / 2 / factor).
+ */
+void designDecimationFilter(const uint8_t factor, float32_t* pCoeffs, const uint16_t numTaps)
+{
+    const float32_t transitionWidth = 5.5f / (float32_t)numTaps;
+    const float32_t cutoff = 0.5f / (float32_t)factor - transitionWidth / 2.0f;
+    const float32_t center = (float32_t)(numTaps - 1) / 2.0f;
+
+    float32_t sum = 0.0f;
+    for (uint16_t i = 0; i < numTaps; i++)
+    {
+        const float32_t x = (float32_t)i - center;
+        const float32_t sinc = x == 0.0f ? 2.0f * cutoff : arm_sin_f32(2.0f * PI * cutoff * x) / (PI * x);
+        const float32_t phase = 2.0f * PI * (float32_t)i / (float32_t)(numTaps - 1);
+        const float32_t window = 0.42f - 0.5f * arm_cos_f32(phase) + 0.08f * arm_cos_f32(2.0f * phase);
+        pCoeffs[i] = sinc * window;
+        sum += pCoeffs[i];
+    }
+
+    for (uint16_t i = 0; i < numTaps; i++)
+    {
+        pCoeffs[i] /= sum;
+    }
+}
+
+void initDecimator(const uint8_t factor)
+{
+    const uint16_t numTaps = DECIMATOR_TAPS_PER_PHASE * factor;
+    float32_t pCoeffs[DECIMATOR_MAX_TAPS];
+
+    designDecimationFilter(factor, pCoeffs, numTaps);
+    arm_float_to_q15(pCoeffs, pDecimatorCoeffs, numTaps);
+    arm_fir_decimate_init_q15(&decimatorInstance, numTaps, factor, pDecimatorCoeffs, pDecimatorState,
+                              DECIMATOR_BLOCK_LEN);
+}
+
+/*
+ * Decimates one DMA block of DECIMATOR_BLOCK_LEN raw samples and returns the number of
+ * samples written to pDst.
+ */
+uint16_t decimateAdcBlock(const uint16_t* pSrc, uint16_t* pDst)
+{
+    for (uint16_t i = 0; i < DECIMATOR_BLOCK_LEN; i++)
+    {
+        pDecimatorInput[i] = (q15_t)((pSrc[i] << ADC_TO_Q15_SHIFT) - (ADC_MIDSCALE << ADC_TO_Q15_SHIFT));
+    }
+
+    arm_fir_decimate_q15(&decimatorInstance, pDecimatorInput, (q15_t*)pDst, DECIMATOR_BLOCK_LEN);
+
+    const uint16_t outputLen = DECIMATOR_BLOCK_LEN / decimatorInstance.M;
+    for (uint16_t i = 0; i < outputLen; i++)
+    {
+        pDst[i] ^= Q15_OFFSET;
+    }
+    return outputLen;
+}
@@ -0,0 +1,229 @@
+#include "fundamental_estimator.h"
+
+/*
+ * Picks the band bin of the fundamental from squared band magnitudes. The strongest bin
+ * is often the 2nd or 3rd harmonic of a wound string, which shows up as an octave or a
+ * fifth jump on the display. Both harmonic estimators score every candidate bin k from
+ * the bins at h * k:
+ *
+ *   harmonic product  - product of the powers for h = 1 .. HARMONIC_PRODUCT_HARMONICS; a
+ *                       subharmonic candidate is multiplied by the noise between the
+ *                       partials and drops out
+ *   subharmonic sum   - sum of the magnitudes weighted by SUBHARMONIC_SUM_DECAY^(h - 1)
+ *                       (Hermes), harmonics above the band count as zero
+ *
+ * A partial of a fractional f0 lands up to h / 2 bins away from h * k, so each harmonic
+ * takes the largest of the three bins around h * k. Scores are not stored: the candidates
+ * are scored one by one against a running maximum, so the band magnitudes are left intact
+ * for the peak interpolation and no extra buffer is needed.
+ */
+
+#ifdef HARMONIC_SUMMATION
+FundamentalEstimator FUNDAMENTAL_ESTIMATOR = FUNDAMENTAL_SUBHARMONIC_SUM;
+#else
+FundamentalEstimator FUNDAMENTAL_ESTIMATOR = FUNDAMENTAL_STRONGEST_BIN;
+#endif // HARMONIC_SUMMATION
+const uint8_t HARMONIC_PRODUCT_HARMONICS = 4; // 350 Hz with the default band, above E4
+const uint8_t SUBHARMONIC_SUM_HARMONICS = 8;
+const float32_t SUBHARMONIC_SUM_DECAY = 0.84f;
+
+/*
+ * Largest power of the three bins around idx, 0 when the harmonic is above the band.
+ */
+static float32_t harmonicPower(const float32_t* pBandMag, const uint16_t binCount, const uint32_t idx)
+{
+    if (idx >= binCount)
+    {
+        return 0.0f;
+    }
+    float32_t power = pBandMag[idx];
+    if (idx > 0 && pBandMag[idx - 1] > power)
+    {
+        power = pBandMag[idx - 1];
+    }
+    if (idx + 1 < binCount && pBandMag[idx + 1] > power)
+    {
+        power = pBandMag[idx + 1];
+    }
+    return power;
+}
+
+static float32_t harmonicPowerQ15(const q15_t* pBandMag, const uint16_t binCount, const uint32_t idx)
+{
+    if (idx >= binCount)
+    {
+        return 0.0f;
+    }
+    q15_t power = pBandMag[idx];
+    if (idx > 0 && pBandMag[idx - 1] > power)
+    {
+        power = pBandMag[idx - 1];
+    }
+    if (idx + 1 < binCount && pBandMag[idx + 1] > power)
+    {
+        power = pBandMag[idx + 1];
+    }
+    return (float32_t)power;
+}
+
+/*
+ * Band index of the harmonic, or binCount when it is above the band. Candidates are
+ * absolute bins so the harmonics of bin k are at h * k even when the band starts above 0.
+ */
+static uint32_t harmonicIdx(const SpectrumBand* pBand, const uint32_t candidateIdx, const uint8_t harmonic)
+{
+    const uint32_t harmonicBin = harmonic * (pBand->firstBin + candidateIdx);
+    const uint32_t idx = harmonicBin - pBand->firstBin;
+    return idx < pBand->binCount ? idx : pBand->binCount;
+}
+
+/*
+ * Candidates scored by the estimator, 0 when the band is too narrow for the harmonic
+ * product and the strongest bin has to do.
+ */
+static uint32_t findCandidateCount(const SpectrumBand* pBand)
+{
+    if (FUNDAMENTAL_ESTIMATOR != FUNDAMENTAL_HARMONIC_PRODUCT)
+    {
+        return pBand->binCount;
+    }
+    // Only candidates with every product harmonic inside the band are comparable
+    const uint32_t lastBin = pBand->firstBin + pBand->binCount - 1;
+    const uint32_t lastCandidateBin = lastBin / HARMONIC_PRODUCT_HARMONICS;
+    return lastCandidateBin >= pBand->firstBin ? lastCandidateBin - pBand->firstBin + 1 : 0;
+}
+
+/*
+ * The best candidate can sit one bin beside the partial it stands for, move it onto the
+ * local maximum so the interpolation sees the actual peak.
+ */
+static uint32_t climbToPeak(const float32_t* pBandMag, const uint16_t binCount, uint32_t idx)
+{
+    if (idx > 0 && pBandMag[idx - 1] > pBandMag[idx])
+    {
+        idx--;
+    }
+    else if (idx + 1 < binCount && pBandMag[idx + 1] > pBandMag[idx])
+    {
+        idx++;
+    }
+    return idx;
+}
+
+static uint32_t climbToPeakQ15(const q15_t* pBandMag, const uint16_t binCount, uint32_t idx)
+{
+    if (idx > 0 && pBandMag[idx - 1] > pBandMag[idx])
+    {
+        idx--;
+    }
+    else if (idx + 1 < binCount && pBandMag[idx + 1] > pBandMag[idx])
+    {
+        idx++;
+    }
+    return idx;
+}
+
+uint32_t findFundamentalBin(const float32_t* pBandMag, const SpectrumBand* pBand)
+{
+    float32_t bestScore = 0.0f;
+    uint32_t bestIdx = 0;
+    const uint32_t candidateCount = findCandidateCount(pBand);
+    if (FUNDAMENTAL_ESTIMATOR == FUNDAMENTAL_STRONGEST_BIN || candidateCount == 0)
+    {
+        arm_max_f32(pBandMag, pBand->binCount, &bestScore, &bestIdx);
+        return bestIdx;
+    }
+
+    for (uint32_t candidateIdx = 0; candidateIdx < candidateCount; candidateIdx++)
+    {
+        float32_t score = 0.0f;
+        if (FUNDAMENTAL_ESTIMATOR == FUNDAMENTAL_HARMONIC_PRODUCT)
+        {
+            score = pBandMag[candidateIdx];
+            for (uint8_t harmonic = 2; harmonic <= HARMONIC_PRODUCT_HARMONICS; harmonic++)
+            {
+                score *= harmonicPower(pBandMag, pBand->binCount, harmonicIdx(pBand, candidateIdx, harmonic));
+            }
+        }
+        else
+        {
+            float32_t weight = 1.0f;
+            for (uint8_t harmonic = 1; harmonic <= SUBHARMONIC_SUM_HARMONICS; harmonic++)
+            {
+                const uint32_t idx = harmonicIdx(pBand, candidateIdx, harmonic);
+                if (idx >= pBand->binCount)
+                {
+                    break;
+                }
+                float32_t magnitude = 0.0f;
+                arm_sqrt_f32(harmonic == 1 ? pBandMag[idx] : harmonicPower(pBandMag, pBand->binCount, idx),
+                             &magnitude);
+                score += weight * magnitude;
+                weight *= SUBHARMONIC_SUM_DECAY;
+            }
+        }
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestIdx = candidateIdx;
+        }
+    }
+    return climbToPeak(pBandMag, pBand->binCount, bestIdx);
+}
+
+/*
+ * Same scoring on the 3.13 magnitudes of the FFT_Q15 pipeline. The products and sums are
+ * formed in float one bin at a time, the band itself is not converted.
+ */
+uint32_t findFundamentalBinQ15(const q15_t* pBandMag, const SpectrumBand* pBand)
+{
+    const uint32_t candidateCount = findCandidateCount(pBand);
+    if (FUNDAMENTAL_ESTIMATOR == FUNDAMENTAL_STRONGEST_BIN || candidateCount == 0)
+    {
+        q15_t maxMag = 0;
+        uint32_t maxMagIdx = 0;
+        arm_max_q15(pBandMag, pBand->binCount, &maxMag, &maxMagIdx);
+        return maxMagIdx;
+    }
+
+    float32_t bestScore = 0.0f;
+    uint32_t bestIdx = 0;
+    for (uint32_t candidateIdx = 0; candidateIdx < candidateCount; candidateIdx++)
+    {
+        float32_t score = 0.0f;
+        if (FUNDAMENTAL_ESTIMATOR == FUNDAMENTAL_HARMONIC_PRODUCT)
+        {
+            score = (float32_t)pBandMag[candidateIdx];
+            for (uint8_t harmonic = 2; harmonic <= HARMONIC_PRODUCT_HARMONICS; harmonic++)
+            {
+                score *= harmonicPowerQ15(pBandMag, pBand->binCount, harmonicIdx(pBand, candidateIdx, harmonic));
+            }
+        }
+        else
+        {
+            float32_t weight = 1.0f;
+            for (uint8_t harmonic = 1; harmonic <= SUBHARMONIC_SUM_HARMONICS; harmonic++)
+            {
+                const uint32_t idx = harmonicIdx(pBand, candidateIdx, harmonic);
+                if (idx >= pBand->binCount)
+                {
+                    break;
+                }
+                float32_t magnitude = 0.0f;
+                const float32_t power = harmonic == 1 ? (float32_t)pBandMag[idx]
+                                                      : harmonicPowerQ15(pBandMag, pBand->binCount, idx);
+                arm_sqrt_f32(power, &magnitude);
+                score += weight * magnitude;
+                weight *= SUBHARMONIC_SUM_DECAY;
+            }
+        }
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestIdx = candidateIdx;
+        }
+    }
+    return climbToPeakQ15(pBandMag, pBand->binCount, bestIdx);
+}
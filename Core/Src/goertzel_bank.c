@@ -0,0 +1,173 @@
+#include "goertzel_bank.h"
+#include <main.h>
+#include "adc_data.h"
+#include "peak_interpolation.h"
+#include "window.h"
+
+/*
+ * Bank of Goertzel filters around a single target frequency for guided tuning of one
+ * string. It runs in the ADC interrupt on every chunk as it is appended to the history,
+ * so a result needs neither a normalised frame buffer nor a full FFT:
+ *     s[n] = w[n] x[n] + 2 cos(2 pi f / fs) s[n - 1] - s[n - 2]
+ *     |X(f)|^2 = s[N - 1]^2 + s[N - 2]^2 - 2 cos(2 pi f / fs) s[N - 1] s[N - 2]
+ * for each of the GOERTZEL_BANK_SIZE frequencies, two floats of state per filter.
+ *
+ * The filters are equally spaced in cents. At the end of a frame of frameLength samples
+ * the strongest one is refined with PEAK_INTERPOLATION on the cents axis, which resolves
+ * much finer than the filter spacing. The frame is weighted with ANALYSIS_WINDOW from the
+ * window tables. The DC bias is removed with the mean of the previous frame. The cosines
+ * are recomputed between frames, so they follow the sample rate calibration.
+ *
+ * Frames run back to back and are restarted on an onset. frameLength must be a multiple of
+ * the chunk length so frames end on chunk boundaries.
+ */
+
+float32_t GOERTZEL_BANK_SPAN_CENTS = 100.0f;
+
+static volatile bool isBankActive = false;
+static float32_t targetFreq = 0.0f;
+static uint16_t frameLen = 0;
+static uint16_t frameSample = 0;
+static const float32_t* pFrameWindow = NULL;
+static float32_t dcOffset = 0.0f;
+static uint32_t dcSum = 0;
+
+static float32_t pCoeffs[GOERTZEL_BANK_SIZE];
+static float32_t pState1[GOERTZEL_BANK_SIZE]; // s[n - 1]
+static float32_t pState2[GOERTZEL_BANK_SIZE]; // s[n - 2]
+static float32_t pWeighted[ADC_CHUNK_LEN]; // Chunk being filtered, only the ADC interrupt touches it
+
+static volatile GoertzelResult lastResult = {0};
+static volatile bool isResultReady = false;
+
+static float32_t getFilterCents(const float32_t filterIdx)
+{
+    const float32_t step = 2.0f * GOERTZEL_BANK_SPAN_CENTS / (float32_t)(GOERTZEL_BANK_SIZE - 1);
+    return -GOERTZEL_BANK_SPAN_CENTS + filterIdx * step;
+}
+
+static void resetFrame()
+{
+    for (uint8_t k = 0; k < GOERTZEL_BANK_SIZE; k++)
+    {
+        const float32_t frequency = targetFreq * powf(2.0f, getFilterCents((float32_t)k) / 1200.0f);
+        pCoeffs[k] = 2.0f * arm_cos_f32(2.0f * PI * frequency / ADC_SAMPLING_FREQ);
+    }
+    arm_fill_f32(0.0f, pState1, GOERTZEL_BANK_SIZE);
+    arm_fill_f32(0.0f, pState2, GOERTZEL_BANK_SIZE);
+    frameSample = 0;
+    dcSum = 0;
+}
+
+void startGoertzelBank(const float32_t targetFrequency, const uint16_t frameLength)
+{
+    isBankActive = false;
+    targetFreq = targetFrequency;
+    frameLen = frameLength;
+    pFrameWindow = getWindowTable(ANALYSIS_WINDOW, frameLength);
+    dcOffset = (float32_t)(1UL << (AUDIO_SAMPLE_BITS - 1));
+    isResultReady = false;
+    resetFrame();
+    isBankActive = true;
+}
+
+void stopGoertzelBank()
+{
+    isBankActive = false;
+    isResultReady = false;
+}
+
+/*
+ * Drops the frame in progress, called from the ADC interrupt when an onset is detected so
+ * no frame mixes two notes.
+ */
+void restartGoertzelFrame()
+{
+    if (isBankActive)
+    {
+        resetFrame();
+    }
+}
+
+static void finishFrame()
+{
+    float32_t pPower[GOERTZEL_BANK_SIZE];
+    for (uint8_t k = 0; k < GOERTZEL_BANK_SIZE; k++)
+    {
+        pPower[k] = pState1[k] * pState1[k] + pState2[k] * pState2[k] - pCoeffs[k] * pState1[k] * pState2[k];
+    }
+    float32_t maxPower = 0.0f;
+    uint32_t maxIdx = 0;
+    arm_max_f32(pPower, GOERTZEL_BANK_SIZE, &maxPower, &maxIdx);
+    const SpectralPeak peak = interpolatePeak(pPower, GOERTZEL_BANK_SIZE, maxIdx, PEAK_INTERPOLATION);
+    const float32_t cents = getFilterCents(peak.bin);
+
+    lastResult.targetFrequency = targetFreq;
+    lastResult.frequency = targetFreq * powf(2.0f, cents / 1200.0f);
+    lastResult.centsDeviation = cents;
+    lastResult.magnitude = peak.magnitude;
+    lastResult.isInRange = maxIdx > 0 && maxIdx < GOERTZEL_BANK_SIZE - 1;
+    isResultReady = true;
+
+    dcOffset = (float32_t)dcSum / (float32_t)frameLen;
+    resetFrame();
+}
+
+/*
+ * Called from the ADC interrupt with each new chunk of the analysed input. The chunk is
+ * centred and windowed once, then each filter runs over it with its state in registers.
+ */
+void updateGoertzelBank(const uint16_t* pChunk, const uint16_t length)
+{
+    if (!isBankActive)
+    {
+        return;
+    }
+
+    const float32_t scale = 2.0f / (float32_t)((1UL << AUDIO_SAMPLE_BITS) - 1);
+    for (uint16_t i = 0; i < length; i++)
+    {
+        const uint16_t sample = pChunk[i * AUDIO_INPUT_COUNT];
+        const float32_t weight = pFrameWindow != NULL ? pFrameWindow[getWindowTableIdx(frameSample + i, frameLen)] : 1.0f;
+        dcSum += sample;
+        pWeighted[i] = ((float32_t)sample - dcOffset) * scale * weight;
+    }
+
+    for (uint8_t k = 0; k < GOERTZEL_BANK_SIZE; k++)
+    {
+        const float32_t coeff = pCoeffs[k];
+        float32_t state1 = pState1[k];
+        float32_t state2 = pState2[k];
+        for (uint16_t i = 0; i < length; i++)
+        {
+            const float32_t state0 = pWeighted[i] + coeff * state1 - state2;
+            state2 = state1;
+            state1 = state0;
+        }
+        pState1[k] = state1;
+        pState2[k] = state2;
+    }
+
+    frameSample += length;
+    if (frameSample >= frameLen)
+    {
+        finishFrame();
+    }
+}
+
+/*
+ * Copies the result of the last finished frame. Returns false when no frame has finished
+ * since the previous call.
+ */
+bool takeGoertzelResult(GoertzelResult* pResult)
+{
+    __disable_irq();
+    const bool isReady = isResultReady;
+    if (isReady)
+    {
+        *pResult = lastResult;
+        isResultReady = false;
+    }
+    __enable_irq();
+    return isReady;
+}
@@ -0,0 +1,221 @@
+#include "inharmonicity.h"
+#include <string.h>
+#include "partial_tracker.h"
+
+/*
+ * Stiffness of a steel string stretches its partials: partial h is at
+ * h * f0 * sqrt(1 + B * h^2) instead of h * f0. With the B of a wound low string around
+ * 1e-4 the 8th partial is 10 cents sharp of 8 * f0, which biases every method that assumes
+ * a harmonic series.
+ *
+ * The partials followed by the partial tracker are fitted to that model by weighted least
+ * squares. Squared and divided by h^2 it is linear in h^2:
+ *
+ *     (f_h / h)^2 = f0^2 + f0^2 * B * h^2
+ *
+ * so the intercept gives f0 and the slope over the intercept gives B. A partial is weighted
+ * with h^2, because the error of its peak, about constant in Hz, is divided by h in f0, and
+ * with its magnitude relative to the fundamental for its SNR. The fundamental has been
+ * refined by the zoom transform and the phase vocoder, the harmonics only by
+ * PEAK_INTERPOLATION, so it weighs INHARMONIC_FUNDAMENTAL_WEIGHT times more and the fit
+ * keeps its precision while the harmonics decide B. The fit quality is the weighted RMS
+ * distance of the partials to the fitted model, in cents.
+ *
+ * B depends on the string more than on the note, so accepted fits are smoothed into
+ * INHARMONIC_STRINGS, one entry per open string, each with a weight growing with its
+ * number of partials. The stored B places the free tracks of the
+ * partial tracker where the partials are, and lets a frame with fewer than
+ * INHARMONIC_MIN_PARTIALS partials, early in the note or late in its decay, fit f0 alone.
+ * INHARMONIC_STRINGS is kept from note to note and only cleared by resetInharmonicity().
+ */
+
+bool INHARMONIC_FIT = true;
+uint8_t INHARMONIC_MIN_PARTIALS = 3;
+float32_t INHARMONIC_MAX_B = 1e-3f;
+float32_t INHARMONIC_MAX_RESIDUAL_CENTS = 2.0f;
+float32_t INHARMONIC_B_SMOOTHING = 0.25f;
+float32_t INHARMONIC_STRING_CENTS = 200.0f;
+float32_t INHARMONIC_FUNDAMENTAL_WEIGHT = 16.0f;
+StringInharmonicity INHARMONIC_STRINGS[GUIDED_STRING_COUNT] = {0};
+
+void resetInharmonicity()
+{
+    memset(INHARMONIC_STRINGS, 0, sizeof(INHARMONIC_STRINGS));
+}
+
+/*
+ * String a note at frequency is played on: the guided string when there is one, otherwise
+ * the open string within INHARMONIC_STRING_CENTS, or GUIDED_STRING_NONE.
+ */
+GuidedString findInharmonicString(const float32_t frequency)
+{
+    if (GUIDED_STRING != GUIDED_STRING_NONE)
+    {
+        return GUIDED_STRING;
+    }
+    if (frequency <= 0.0f)
+    {
+        return GUIDED_STRING_NONE;
+    }
+
+    GuidedString nearest = GUIDED_STRING_NONE;
+    float32_t nearestCents = INHARMONIC_STRING_CENTS;
+    for (GuidedString string = GUIDED_STRING_E2; string < GUIDED_STRING_COUNT; string++)
+    {
+        const float32_t cents = fabsf(1200.0f * log2f(frequency / GUIDED_STRING_FREQS[string]));
+        if (cents <= nearestCents)
+        {
+            nearestCents = cents;
+            nearest = string;
+        }
+    }
+    return nearest;
+}
+
+/*
+ * Stored B of the string of a note at frequency, 0 while it is unknown.
+ */
+float32_t getStringInharmonicity(const float32_t frequency)
+{
+    const GuidedString string = findInharmonicString(frequency);
+    return string != GUIDED_STRING_NONE ? INHARMONIC_STRINGS[string].b : 0.0f;
+}
+
+/*
+ * Frequency of partial harmonic of a string with coefficient b whose first partial is at
+ * fundamentalFreq, which is itself f0 * sqrt(1 + b).
+ */
+float32_t predictPartialFrequency(const float32_t fundamentalFreq, const uint8_t harmonic, const float32_t b)
+{
+    const float32_t h2 = (float32_t)harmonic * (float32_t)harmonic;
+    return (float32_t)harmonic * fundamentalFreq * sqrtf((1.0f + b * h2) / (1.0f + b));
+}
+
+/*
+ * Intercept of the model with b fixed: least squares of w * (y - a * (1 + b * x))^2, with
+ * y relative to 1 in pY.
+ */
+static float32_t fitIntercept(const float32_t* pX, const float32_t* pY, const float32_t* pW, const uint8_t count,
+                              const float32_t b)
+{
+    float32_t num = 0.0f;
+    float32_t den = 0.0f;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const float32_t stretch = 1.0f + b * pX[i];
+        num += pW[i] * (1.0f + pY[i]) * stretch;
+        den += pW[i] * stretch * stretch;
+    }
+    return num / den;
+}
+
+/*
+ * Fits f0 and B to the partials the tracker found in this frame. Returns true when the fit
+ * is within INHARMONIC_MAX_RESIDUAL_CENTS; pFit is filled whenever there was a fit.
+ */
+bool fitInharmonicity(InharmonicFit* pFit)
+{
+    const PartialTrack* pFundamental = &PARTIAL_TRACKS[0];
+    if (!INHARMONIC_FIT || pFundamental->age == 0 || pFundamental->missedFrames > 0 ||
+        pFundamental->amplitude <= 0.0f)
+    {
+        return false;
+    }
+
+    // y is (f_h / (h * f_1))^2 - 1, small, so the slope keeps its precision in single precision
+    float32_t pX[PARTIAL_TRACK_COUNT];
+    float32_t pY[PARTIAL_TRACK_COUNT];
+    float32_t pW[PARTIAL_TRACK_COUNT];
+    uint8_t count = 0;
+    for (uint8_t harmonic = 1; harmonic <= PARTIAL_TRACK_COUNT; harmonic++)
+    {
+        const PartialTrack* pTrack = &PARTIAL_TRACKS[harmonic - 1];
+        if (pTrack->age == 0 || pTrack->missedFrames > 0)
+        {
+            continue;
+        }
+        const float32_t h2 = (float32_t)harmonic * (float32_t)harmonic;
+        const float32_t ratio = pTrack->frequency / ((float32_t)harmonic * pFundamental->frequency);
+        pX[count] = h2;
+        pY[count] = (ratio - 1.0f) * (ratio + 1.0f);
+        pW[count] = h2 * sqrtf(pTrack->amplitude / pFundamental->amplitude);
+        pW[count] *= harmonic == 1 ? INHARMONIC_FUNDAMENTAL_WEIGHT : 1.0f;
+        count++;
+    }
+
+    const GuidedString string = findInharmonicString(pFundamental->frequency);
+    const bool storedB = string != GUIDED_STRING_NONE && INHARMONIC_STRINGS[string].fitCount > 0;
+    float32_t b = storedB ? INHARMONIC_STRINGS[string].b : 0.0f;
+    float32_t a = 0.0f;
+    pFit->fixedB = count < INHARMONIC_MIN_PARTIALS || count < 3; // Two partials always fit exactly
+    if (pFit->fixedB)
+    {
+        if (count < 2 || !storedB)
+        {
+            return false;
+        }
+        a = fitIntercept(pX, pY, pW, count, b);
+    }
+    else
+    {
+        float32_t sumW = 0.0f;
+        float32_t meanX = 0.0f;
+        float32_t meanY = 0.0f;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            sumW += pW[i];
+            meanX += pW[i] * pX[i];
+            meanY += pW[i] * pY[i];
+        }
+        meanX /= sumW;
+        meanY /= sumW;
+
+        float32_t sxx = 0.0f;
+        float32_t sxy = 0.0f;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            sxx += pW[i] * (pX[i] - meanX) * (pX[i] - meanX);
+            sxy += pW[i] * (pX[i] - meanX) * (pY[i] - meanY);
+        }
+        const float32_t slope = sxy / sxx;
+        a = 1.0f + meanY - slope * meanX;
+        b = slope / a;
+        if (b < 0.0f || b > INHARMONIC_MAX_B)
+        {
+            b = fminf(fmaxf(b, 0.0f), INHARMONIC_MAX_B); // Outside the physics, refit f0 on the bound
+            a = fitIntercept(pX, pY, pW, count, b);
+        }
+    }
+    if (a <= 0.0f)
+    {
+        return false;
+    }
+
+    pFit->f0 = pFundamental->frequency * sqrtf(a);
+    pFit->b = b;
+    pFit->partialCount = count;
+
+    float32_t sumW = 0.0f;
+    float32_t sumSquares = 0.0f;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const float32_t cents = 600.0f * log2f((1.0f + pY[i]) / (a * (1.0f + b * pX[i])));
+        const float32_t weight = i == 0 ? pW[i] / INHARMONIC_FUNDAMENTAL_WEIGHT : pW[i]; // All partials alike
+        sumW += weight;
+        sumSquares += weight * cents * cents;
+    }
+    pFit->residualCents = sqrtf(sumSquares / sumW);
+    if (pFit->residualCents > INHARMONIC_MAX_RESIDUAL_CENTS)
+    {
+        return false;
+    }
+
+    if (!pFit->fixedB && string != GUIDED_STRING_NONE)
+    {
+        StringInharmonicity* pString = &INHARMONIC_STRINGS[string];
+        const float32_t weight = INHARMONIC_B_SMOOTHING * (float32_t)count / (float32_t)PARTIAL_TRACK_COUNT;
+        pString->b = pString->fitCount > 0 ? pString->b + weight * (b - pString->b) : b; // Few partials move it less
+        pString->fitCount = pString->fitCount < UINT16_MAX ? pString->fitCount + 1 : UINT16_MAX;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#include "input_selector.h"
+#include "adc_data.h"
+
+/*
+ * Chooses, for every analysis block, which of the AUDIO_INPUT_COUNT interleaved inputs is
+ * analysed. Each input keeps a noise floor estimate that follows its quietest blocks
+ * immediately and rises slowly otherwise, and the block SNR is its RMS over that floor.
+ * The selection switches only when another input beats the current one by
+ * INPUT_SWITCH_MARGIN, so two similar inputs do not alternate from block to block.
+ * A clipping input counts as if it had no SNR advantage at all.
+ */
+
+static const float32_t NOISE_FLOOR_RISE = 1.05f; // Per block, about 0.4 dB/s at 8 kHz
+static const float32_t MIN_NOISE_FLOOR = 1.0e-4f; // Relative to full scale, keeps the ratio finite
+
+float32_t INPUT_SWITCH_MARGIN = 2.0f; // 6 dB
+
+static uint8_t selectedInput = 0;
+static bool hasNoiseFloor = false;
+static float32_t pNoiseFloor[AUDIO_INPUT_COUNT];
+
+void resetInputSelector()
+{
+    hasNoiseFloor = false;
+}
+
+uint8_t selectAudioInput(const uint16_t* pHistory, const uint32_t startSample, const uint16_t length,
+                         SignalGateStats* pStats)
+{
+    SignalGateStats pInputStats[AUDIO_INPUT_COUNT];
+    float32_t pSnr[AUDIO_INPUT_COUNT];
+
+    for (uint8_t input = 0; input < AUDIO_INPUT_COUNT; input++)
+    {
+        calculateSignalStats(pHistory + input, startSample, length, &pInputStats[input]);
+        const float32_t rms = pInputStats[input].rms;
+
+        float32_t floor = hasNoiseFloor ? pNoiseFloor[input] * NOISE_FLOOR_RISE : rms;
+        floor = rms < floor ? rms : floor;
+        floor = floor > MIN_NOISE_FLOOR ? floor : MIN_NOISE_FLOOR;
+        pNoiseFloor[input] = floor;
+
+        pSnr[input] = pInputStats[input].clippedSamples > 0 ? 1.0f : rms / floor;
+    }
+    hasNoiseFloor = true;
+
+    uint8_t bestInput = selectedInput;
+    for (uint8_t input = 0; input < AUDIO_INPUT_COUNT; input++)
+    {
+        if (pSnr[input] > pSnr[bestInput])
+        {
+            bestInput = input;
+        }
+    }
+    if (pSnr[bestInput] > INPUT_SWITCH_MARGIN * pSnr[selectedInput])
+    {
+        selectedInput = bestInput;
+    }
+
+    *pStats = pInputStats[selectedInput];
+    return selectedInput;
+}
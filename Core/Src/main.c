@@ -31,6 +31,8 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define ADC_MAX_CLOCK_FREQ 36000000U // ADC clock limit for VDDA >= 2.4 V
+#define HSE_PLL_INPUT_FREQ 1000000U // VCO input after the PLLM divider
 
 /* USER CODE END PD */
 
@@ -46,6 +48,8 @@ DMA_HandleTypeDef hdma_adc1;
 I2C_HandleTypeDef hi2c1;
 DMA_HandleTypeDef hdma_i2c1_tx;
 
+TIM_HandleTypeDef htim2;
+
 UART_HandleTypeDef huart1;
 DMA_HandleTypeDef hdma_usart1_tx;
 
@@ -60,10 +64,33 @@ static void MX_DMA_Init(void);
 static void MX_ADC1_Init(void);
 static void MX_I2C1_Init(void);
 static void MX_USART1_UART_Init(void);
+static void MX_TIM2_Init(void);
 /* USER CODE BEGIN PFP */
+static HAL_StatusTypeDef SystemClock_ConfigHse(uint32_t sysclkFreq);
+static uint32_t selectAdcClockPrescaler(void);
+
+/*
+ * Clock profiles, selected with CLOCK_PROFILE in CMake:
+ *   HSI_25MHZ  - the CubeMX configuration: HSI PLL, 50 MHz SYSCLK, 25 MHz HCLK
+ *   HSE_96MHZ  - 25 MHz crystal PLL, 96 MHz HCLK
+ *   HSE_100MHZ - 25 MHz crystal PLL, 100 MHz HCLK
+ * An HSE profile falls back to the HSI one when the crystal does not start.
+ */
 __inline void SystemClockConfig(void)
 {
+#if defined(CLOCK_PROFILE_HSE_100MHZ)
+    if (SystemClock_ConfigHse(100000000U) != HAL_OK)
+    {
+        SystemClock_Config();
+    }
+#elif defined(CLOCK_PROFILE_HSE_96MHZ)
+    if (SystemClock_ConfigHse(96000000U) != HAL_OK)
+    {
+        SystemClock_Config();
+    }
+#else
     SystemClock_Config();
+#endif
 }
 
 __inline void MxGpioInit(void)
@@ -90,10 +117,94 @@ __inline void MxI2cInit(void)
 {
   MX_I2C1_Init();
 }
+
+__inline void MxTimInit(void)
+{
+  MX_TIM2_Init();
+}
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+/*
+ * Wait states for VDD 2.7..3.6 V (RM0383, table 5): one more for every 30 MHz of HCLK.
+ */
+static uint32_t selectFlashLatency(const uint32_t hclkFreq)
+{
+  if (hclkFreq <= 30000000U)
+  {
+    return FLASH_LATENCY_0;
+  }
+  if (hclkFreq <= 64000000U)
+  {
+    return FLASH_LATENCY_1;
+  }
+  if (hclkFreq <= 90000000U)
+  {
+    return FLASH_LATENCY_2;
+  }
+  return FLASH_LATENCY_3;
+}
+
+/*
+ * HSE -> PLL with a 1 MHz VCO input. AHB and APB2 run at SYSCLK and APB1 at half of it,
+ * which keeps APB1 within its 50 MHz limit. The ART accelerator (prefetch, instruction
+ * and data caches) is already enabled by HAL_Init() from stm32f4xx_hal_conf.h, and
+ * HAL_RCC_ClockConfig() raises the flash latency before switching to the faster clock.
+ */
+static HAL_StatusTypeDef SystemClock_ConfigHse(const uint32_t sysclkFreq)
+{
+  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+  RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+  __HAL_RCC_PWR_CLK_ENABLE();
+  __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
+
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+  RCC_OscInitStruct.HSEState = RCC_HSE_ON;
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+  RCC_OscInitStruct.PLL.PLLM = HSE_VALUE / HSE_PLL_INPUT_FREQ;
+  RCC_OscInitStruct.PLL.PLLN = 2 * sysclkFreq / HSE_PLL_INPUT_FREQ;
+  RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
+  RCC_OscInitStruct.PLL.PLLQ = 4;
+  if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+  {
+    return HAL_ERROR;
+  }
+
+  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+                              |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+  RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+
+  return HAL_RCC_ClockConfig(&RCC_ClkInitStruct, selectFlashLatency(sysclkFreq));
+}
+
+/*
+ * Smallest PCLK2 divider that keeps the ADC clock within its limit, so the ADC follows
+ * whichever clock profile is active. I2C and UART derive their timings from the PCLK
+ * frequencies in HAL_I2C_Init() / HAL_UART_Init() and need no adjustment.
+ */
+static uint32_t selectAdcClockPrescaler(void)
+{
+  const uint32_t pclk2 = HAL_RCC_GetPCLK2Freq();
+  if (pclk2 / 2 <= ADC_MAX_CLOCK_FREQ)
+  {
+    return ADC_CLOCK_SYNC_PCLK_DIV2;
+  }
+  if (pclk2 / 4 <= ADC_MAX_CLOCK_FREQ)
+  {
+    return ADC_CLOCK_SYNC_PCLK_DIV4;
+  }
+  if (pclk2 / 6 <= ADC_MAX_CLOCK_FREQ)
+  {
+    return ADC_CLOCK_SYNC_PCLK_DIV6;
+  }
+  return ADC_CLOCK_SYNC_PCLK_DIV8;
+}
 
 /* USER CODE END 0 */
 
@@ -169,13 +280,13 @@ static void MX_ADC1_Init(void)
   /** Configure the global features of the ADC (Clock, Resolution, Data Alignment and number of conversion)
   */
   hadc1.Instance = ADC1;
-  hadc1.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV8;
+  hadc1.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV2;
   hadc1.Init.Resolution = ADC_RESOLUTION_12B;
   hadc1.Init.ScanConvMode = DISABLE;
-  hadc1.Init.ContinuousConvMode = ENABLE;
+  hadc1.Init.ContinuousConvMode = DISABLE;
   hadc1.Init.DiscontinuousConvMode = DISABLE;
-  hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
-  hadc1.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+  hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  hadc1.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T2_TRGO;
   hadc1.Init.DataAlign = ADC_DATAALIGN_RIGHT;
   hadc1.Init.NbrOfConversion = 1;
   hadc1.Init.DMAContinuousRequests = ENABLE;
@@ -189,12 +300,30 @@ static void MX_ADC1_Init(void)
   */
   sConfig.Channel = ADC_CHANNEL_4;
   sConfig.Rank = 1;
-  sConfig.SamplingTime = ADC_SAMPLETIME_84CYCLES;
+  sConfig.SamplingTime = ADC_SAMPLETIME_56CYCLES;
   if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK)
   {
     Error_Handler();
   }
   /* USER CODE BEGIN ADC1_Init 2 */
+#ifdef DUAL_INPUT
+  // Scan the second input right after the first one on every trigger, DMA interleaves them
+  hadc1.Init.ScanConvMode = ENABLE;
+  hadc1.Init.NbrOfConversion = 2;
+  if (HAL_ADC_Init(&hadc1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfig.Channel = ADC_CHANNEL_5;
+  sConfig.Rank = 2;
+  sConfig.SamplingTime = ADC_SAMPLETIME_56CYCLES;
+  if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
+  hadc1.Init.ClockPrescaler = selectAdcClockPrescaler();
+  MODIFY_REG(ADC1_COMMON->CCR, ADC_CCR_ADCPRE, hadc1.Init.ClockPrescaler);
 
   /* USER CODE END ADC1_Init 2 */
 
@@ -234,6 +363,51 @@ static void MX_I2C1_Init(void)
 
 }
 
+/**
+  * @brief TIM2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM2_Init(void)
+{
+
+  /* USER CODE BEGIN TIM2_Init 0 */
+
+  /* USER CODE END TIM2_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM2_Init 1 */
+
+  /* USER CODE END TIM2_Init 1 */
+  htim2.Instance = TIM2;
+  htim2.Init.Prescaler = 0;
+  htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim2.Init.Period = 3124;
+  htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  if (HAL_TIM_Base_Init(&htim2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim2, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim2, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM2_Init 2 */
+
+  /* USER CODE END TIM2_Init 2 */
+
+}
+
 /**
   * @brief USART1 Initialization Function
   * @param None
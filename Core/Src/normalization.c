@@ -0,0 +1,171 @@
+#include "normalization.h"
+#include "adc_data.h"
+#include "signal_gate.h"
+#include "window.h"
+
+/*
+ * Conversion of offset-binary samples from the acquisition history to centred floats in
+ * -1..1 for the FFT.
+ *
+ * normalize() removes the DC bias with a single-pole high-pass
+ *     y[n] = x[n] - x[n - 1] + R * y[n - 1]
+ * fused with the conversion and scaling, so every sample is read once. The filter state
+ * is carried from one block to the next when the blocks are contiguous and come from the
+ * same input. Otherwise (first block, onset realignment, input switch) it is seeded with
+ * the block mean the signal gate computed in the ADC interrupt, which avoids a start-up
+ * step.
+ *
+ * The ANALYSIS_WINDOW weights are applied in the same loop, read from the half tables
+ * generated at build time, so windowing costs a table read and a multiply per sample but no
+ * extra pass.
+ *
+ * normalizeQ15() is the same filter in integer arithmetic for the FFT_Q15 pipeline. The
+ * filter state keeps 8 fractional bits, and the output gets a power-of-two block gain
+ * chosen from the gate's peak, so quiet notes still use most of the q15 range.
+ */
+
+float32_t DC_BLOCKER_CUTOFF_FREQ = 10.0f; // -0.6 dB at A0, negligible from E1 up
+
+static bool isDcBlockerSeeded = false;
+static const uint16_t* pDcBlockerInput = NULL;
+static uint32_t dcBlockerNextSample = 0;
+static int32_t dcBlockerLastInput = 0;
+static float32_t dcBlockerLastOutput = 0.0f;
+
+static const float32_t Q15_TARGET_PEAK = 0.5f; // Block gain aims the peak here, leaving headroom for the filter
+static const uint8_t Q15_STATE_FRACTION_BITS = 8;
+
+static bool isQ15DcBlockerSeeded = false;
+static const uint16_t* pQ15DcBlockerInput = NULL;
+static uint32_t q15DcBlockerNextSample = 0;
+static int32_t q15DcBlockerLastInput = 0;
+static int32_t q15DcBlockerLastOutput = 0; // Sample LSBs with Q15_STATE_FRACTION_BITS fractional bits
+
+static float32_t getSampleScale()
+{
+    const uint32_t ADC_MAX = (1UL << AUDIO_SAMPLE_BITS) - 1; // 4095, or 65535 when oversampling
+    return 2.0f / (float32_t)ADC_MAX;
+}
+
+static float32_t getDcBlockerPole()
+{
+    return 1.0f - 2.0f * PI * DC_BLOCKER_CUTOFF_FREQ / ADC_SAMPLING_FREQ;
+}
+
+void resetDcBlocker()
+{
+    isDcBlockerSeeded = false;
+    isQ15DcBlockerSeeded = false;
+}
+
+void normalize(const uint16_t* pAudioHistory, const uint32_t startSample, float32_t* dst, const size_t len)
+{
+    normalizeWithWindow(pAudioHistory, startSample, dst, len, ANALYSIS_WINDOW);
+}
+
+/*
+ * normalize() with an explicit window, for analyses that need other weights than the
+ * spectrum, such as the unwindowed blocks of the time-domain pitch detectors.
+ */
+void normalizeWithWindow(const uint16_t* pAudioHistory, const uint32_t startSample, float32_t* dst, const size_t len,
+                         const WindowType window)
+{
+    if (!isDcBlockerSeeded || pAudioHistory != pDcBlockerInput || startSample != dcBlockerNextSample)
+    {
+        pDcBlockerInput = pAudioHistory;
+        dcBlockerLastInput = SIGNAL_GATE_STATS.mean;
+        dcBlockerLastOutput = 0.0f;
+        isDcBlockerSeeded = true;
+    }
+
+    const float32_t pole = getDcBlockerPole();
+    const float32_t scale = getSampleScale();
+    const float32_t* pWindow = getWindowTable(window, (uint16_t)len);
+    int32_t lastInput = dcBlockerLastInput;
+    float32_t lastOutput = dcBlockerLastOutput;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        const int32_t input = getAudioSample(pAudioHistory, startSample + i);
+        lastOutput = (float32_t)(input - lastInput) + pole * lastOutput;
+        lastInput = input;
+        const float32_t weight = pWindow != NULL ? pWindow[getWindowTableIdx(i, len)] : 1.0f;
+        dst[i] = lastOutput * scale * weight;
+    }
+
+    dcBlockerLastInput = lastInput;
+    dcBlockerLastOutput = lastOutput;
+    dcBlockerNextSample = startSample + len;
+}
+
+/*
+ * Gain shift that brings the gate's peak closest to Q15_TARGET_PEAK without exceeding it.
+ * Limited so the conversion from state units to q15 stays a right shift.
+ */
+static uint8_t calculateQ15GainShift()
+{
+    const uint8_t maxShift = AUDIO_SAMPLE_BITS - Q15_STATE_FRACTION_BITS;
+    float32_t peak = SIGNAL_GATE_STATS.peak;
+    uint8_t shift = 0;
+    while (shift < maxShift && 2.0f * peak <= Q15_TARGET_PEAK)
+    {
+        peak *= 2.0f;
+        shift++;
+    }
+    return shift;
+}
+
+uint8_t normalizeQ15(const uint16_t* pAudioHistory, const uint32_t startSample, q15_t* dst, const size_t len)
+{
+    if (!isQ15DcBlockerSeeded || pAudioHistory != pQ15DcBlockerInput || startSample != q15DcBlockerNextSample)
+    {
+        pQ15DcBlockerInput = pAudioHistory;
+        q15DcBlockerLastInput = SIGNAL_GATE_STATS.mean;
+        q15DcBlockerLastOutput = 0;
+        isQ15DcBlockerSeeded = true;
+    }
+
+    const q31_t pole = (q31_t)(getDcBlockerPole() * 2147483647.0f);
+    const uint8_t gainShift = calculateQ15GainShift();
+    // A full-scale sample is 2^(AUDIO_SAMPLE_BITS - 1) LSBs, q15 full scale is 2^15
+    const uint8_t outputShift = AUDIO_SAMPLE_BITS - Q15_STATE_FRACTION_BITS - gainShift;
+    const q15_t* pWindow = getWindowTableQ15(ANALYSIS_WINDOW, (uint16_t)len);
+    int32_t lastInput = q15DcBlockerLastInput;
+    int32_t lastOutput = q15DcBlockerLastOutput;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        const int32_t input = getAudioSample(pAudioHistory, startSample + i);
+        lastOutput = ((input - lastInput) << Q15_STATE_FRACTION_BITS) + (int32_t)(((int64_t)pole * lastOutput) >> 31);
+        lastInput = input;
+        const int32_t sample = __SSAT(lastOutput >> outputShift, 16);
+        dst[i] = pWindow != NULL ? (q15_t)((sample * pWindow[getWindowTableIdx(i, len)]) >> 15) : (q15_t)sample;
+    }
+
+    q15DcBlockerLastInput = lastInput;
+    q15DcBlockerLastOutput = lastOutput;
+    q15DcBlockerNextSample = startSample + len;
+    return gainShift;
+}
+
+/*
+ * Previous implementation, kept as the benchmark reference: an integer mean pass over the
+ * block followed by a subtract-and-scale pass.
+ */
+void normalizeBlockMean(const uint16_t* pAudioHistory, const uint32_t startSample, float32_t* dst, const size_t len)
+{
+    const float32_t scale = getSampleScale();
+
+    int32_t mean = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        mean += getAudioSample(pAudioHistory, startSample + i);
+    }
+    mean /= (int32_t)len;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        const int32_t centered = (int32_t)getAudioSample(pAudioHistory, startSample + i) - mean;
+        dst[i] = (float32_t)centered * scale;
+    }
+}
@@ -0,0 +1,63 @@
+#include "onset_detector.h"
+#include "adc_data.h"
+
+/*
+ * Energy onset detector, run in the ADC interrupt on every DMA chunk (on one input of the
+ * interleaved chunk with DUAL_INPUT). The AC energy of the chunk is compared with an
+ * exponential average of the previous chunks; a jump of ONSET_ENERGY_RATIO above a signal
+ * of at least ONSET_MIN_RMS is a pluck. For ONSET_HOLDOFF_MS after an onset the average
+ * keeps following the note but no new onset is reported, so the rest of the attack cannot
+ * trigger again.
+ */
+
+static const float32_t BACKGROUND_SMOOTHING = 0.2f; // Weight of the newest chunk in the background energy
+
+float32_t ONSET_ENERGY_RATIO = 4.0f; // +6 dB
+float32_t ONSET_MIN_RMS = 0.01f; // -40 dBFS, the signal gate's open threshold
+uint16_t ONSET_HOLDOFF_MS = 150;
+uint16_t ONSET_WINDOW_DELAY_MS = 60;
+
+static float32_t backgroundEnergy = 0.0f;
+static uint32_t holdoffSamples = 0;
+
+void resetOnsetDetector()
+{
+    backgroundEnergy = 0.0f;
+    holdoffSamples = 0;
+}
+
+bool detectOnset(const uint16_t* pChunk, const uint16_t length)
+{
+    uint32_t sum = 0;
+    uint64_t sumSq = 0;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        const uint16_t sample = pChunk[i * AUDIO_INPUT_COUNT];
+        sum += sample;
+        sumSq += (uint32_t)sample * sample;
+    }
+
+    // Mean-removed energy per sample, relative to full scale
+    const float32_t halfScale = (float32_t)((1UL << AUDIO_SAMPLE_BITS) - 1) / 2.0f;
+    const uint64_t scaledVariance = (uint64_t)length * sumSq - (uint64_t)sum * sum;
+    const float32_t energy = (float32_t)scaledVariance / ((float32_t)length * (float32_t)length) / (halfScale * halfScale);
+
+    bool isOnset = false;
+    if (holdoffSamples > length)
+    {
+        holdoffSamples -= length;
+    }
+    else
+    {
+        holdoffSamples = 0;
+        isOnset = energy >= ONSET_MIN_RMS * ONSET_MIN_RMS && energy >= ONSET_ENERGY_RATIO * backgroundEnergy;
+    }
+
+    if (isOnset)
+    {
+        holdoffSamples = (uint32_t)(ADC_SAMPLING_FREQ * (float32_t)ONSET_HOLDOFF_MS / 1000.0f);
+    }
+    backgroundEnergy += BACKGROUND_SMOOTHING * (energy - backgroundEnergy);
+
+    return isOnset;
+}
@@ -0,0 +1,161 @@
+#include "partial_tracker.h"
+#include <string.h>
+#include "inharmonicity.h"
+#include "peak_interpolation.h"
+
+/*
+ * Table of the partials of the note being played, carried from one analysis to the next.
+ * Track h - 1 follows harmonic h: a free track is looked for where the stored inharmonicity
+ * of the string puts partial h, a followed one at its own last frequency, so an inharmonic
+ * partial keeps its track.
+ * Each frame a track takes the strongest local maximum within PARTIAL_MATCH_CENTS of where
+ * it was, and only those few bins are read.
+ *
+ * Once the fundamental has been followed for PARTIAL_MIN_AGE frames it is the prior of
+ * calculateStringTuningInfo(): the fundamental is taken from its neighbourhood instead of
+ * the full-band search of findFundamentalBin(), which is both cheaper and immune to the
+ * octave jumps of a decaying note whose upper partials fade at different rates. When that
+ * neighbourhood has no peak, or the peak fell by more than PARTIAL_MIN_RATIO in one frame,
+ * the full search runs again and a different fundamental restarts the table.
+ *
+ * The table is cleared by an onset and when the signal gate closes.
+ */
+
+bool PARTIAL_TRACKING = true;
+float32_t PARTIAL_MATCH_CENTS = 40.0f;
+uint16_t PARTIAL_MIN_AGE = 2;
+uint8_t PARTIAL_MAX_MISSED = 2;
+float32_t PARTIAL_MIN_RATIO = 1e-3f; // -30 dB
+PartialTrack PARTIAL_TRACKS[PARTIAL_TRACK_COUNT] = {0};
+
+static uint32_t lastOnsetSample = AUDIO_NO_ONSET;
+
+void resetPartialTracker()
+{
+    memset(PARTIAL_TRACKS, 0, sizeof(PARTIAL_TRACKS));
+}
+
+/*
+ * Clears the table when pBlock is the first block after a new onset.
+ */
+void startPartialFrame(const AudioBlock* pBlock)
+{
+    if (pBlock->samplesSinceOnset == AUDIO_NO_ONSET)
+    {
+        return;
+    }
+
+    const uint32_t onsetSample = pBlock->startSample - pBlock->samplesSinceOnset;
+    if (onsetSample != lastOnsetSample)
+    {
+        lastOnsetSample = onsetSample;
+        resetPartialTracker();
+    }
+}
+
+/*
+ * Strongest local maximum of the band within PARTIAL_MATCH_CENTS of frequency. The window
+ * is widened by half a bin on each side, the distance between a partial and its peak bin.
+ */
+static bool findPeakNear(const float32_t* pBandMag, const SpectrumBand* pBand, const float32_t frequency,
+                         uint32_t* pPeakIdx)
+{
+    const float32_t binWidth = ADC_SAMPLING_FREQ / (float32_t)pBand->fftLen;
+    const float32_t ratio = exp2f(PARTIAL_MATCH_CENTS / 1200.0f);
+    const float32_t lowIdx = frequency / ratio / binWidth - (float32_t)pBand->firstBin - 0.5f;
+    const float32_t highIdx = frequency * ratio / binWidth - (float32_t)pBand->firstBin + 0.5f;
+    if (pBand->binCount < 3 || highIdx < 1.0f || lowIdx > (float32_t)(pBand->binCount - 2))
+    {
+        return false;
+    }
+
+    // The ends of the band have no outer neighbour to prove a maximum
+    const uint32_t firstIdx = lowIdx > 1.0f ? (uint32_t)floorf(lowIdx) : 1;
+    const uint32_t lastIdx = highIdx < (float32_t)(pBand->binCount - 2) ? (uint32_t)ceilf(highIdx)
+                                                                        : pBand->binCount - 2u;
+    float32_t peak = 0.0f;
+    uint32_t peakIdx = 0;
+    arm_max_f32(pBandMag + firstIdx, lastIdx - firstIdx + 1, &peak, &peakIdx);
+    peakIdx += firstIdx;
+    if (peak <= 0.0f || pBandMag[peakIdx - 1] > peak || pBandMag[peakIdx + 1] > peak)
+    {
+        return false; // Slope of a peak outside the window
+    }
+
+    *pPeakIdx = peakIdx;
+    return true;
+}
+
+/*
+ * Band index of the fundamental from its track, or false when there is no trusted track or
+ * its partial is gone.
+ */
+bool findTrackedFundamentalBin(const float32_t* pBandMag, const SpectrumBand* pBand, uint32_t* pPeakIdx)
+{
+    const PartialTrack* pFundamental = &PARTIAL_TRACKS[0];
+    if (!PARTIAL_TRACKING || pFundamental->age < PARTIAL_MIN_AGE)
+    {
+        return false;
+    }
+
+    uint32_t peakIdx = 0;
+    if (!findPeakNear(pBandMag, pBand, pFundamental->frequency, &peakIdx) ||
+        pBandMag[peakIdx] < PARTIAL_MIN_RATIO * pFundamental->amplitude)
+    {
+        return false;
+    }
+
+    *pPeakIdx = peakIdx;
+    return true;
+}
+
+/*
+ * Feeds the table with the fundamental of this frame, fundamentalIdx in the band and
+ * fundamentalFreq after all refinements, and follows the harmonics around it.
+ */
+void updatePartialTracks(const float32_t* pBandMag, const SpectrumBand* pBand, const uint32_t fundamentalIdx,
+                         const float32_t fundamentalFreq)
+{
+    if (!PARTIAL_TRACKING)
+    {
+        return;
+    }
+
+    PartialTrack* pFundamental = &PARTIAL_TRACKS[0];
+    if (fundamentalFreq <= 0.0f || pFundamental->age == 0 ||
+        fabsf(1200.0f * log2f(fundamentalFreq / pFundamental->frequency)) > PARTIAL_MATCH_CENTS)
+    {
+        resetPartialTracker();
+    }
+    if (fundamentalFreq <= 0.0f)
+    {
+        return;
+    }
+    pFundamental->frequency = fundamentalFreq;
+    pFundamental->amplitude = pBandMag[fundamentalIdx];
+    pFundamental->age = pFundamental->age < UINT16_MAX ? pFundamental->age + 1 : UINT16_MAX;
+    pFundamental->missedFrames = 0;
+
+    const float32_t b = getStringInharmonicity(fundamentalFreq);
+    for (uint8_t harmonic = 2; harmonic <= PARTIAL_TRACK_COUNT; harmonic++)
+    {
+        PartialTrack* pTrack = &PARTIAL_TRACKS[harmonic - 1];
+        const float32_t expectedFreq = pTrack->age > 0 ? pTrack->frequency
+                                                       : predictPartialFrequency(fundamentalFreq, harmonic, b);
+
+        uint32_t peakIdx = 0;
+        if (findPeakNear(pBandMag, pBand, expectedFreq, &peakIdx) &&
+            pBandMag[peakIdx] >= PARTIAL_MIN_RATIO * pFundamental->amplitude)
+        {
+            const SpectralPeak peak = interpolatePeak(pBandMag, pBand->binCount, peakIdx, PEAK_INTERPOLATION);
+            pTrack->frequency = calculateBinFrequency(pBand, peak.bin);
+            pTrack->amplitude = pBandMag[peakIdx];
+            pTrack->age = pTrack->age < UINT16_MAX ? pTrack->age + 1 : UINT16_MAX;
+            pTrack->missedFrames = 0;
+        }
+        else if (pTrack->age > 0 && ++pTrack->missedFrames > PARTIAL_MAX_MISSED)
+        {
+            memset(pTrack, 0, sizeof(*pTrack));
+        }
+    }
+}
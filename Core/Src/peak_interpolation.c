@@ -0,0 +1,122 @@
+#include "peak_interpolation.h"
+
+/*
+ * Sub-bin refinement of a spectral maximum from the bins around it. With the raw bin the
+ * error is up to half a bin, about 40 cents at E2 with 2048 samples at 8 kHz.
+ *
+ * interpolatePeak() works on squared magnitudes, the output of the spectrum stage:
+ *   parabolic - parabola through the three magnitudes; cheap, biased by up to ~0.1 bin
+ *   gaussian  - parabola through the log magnitudes; exact for a Gaussian main lobe and
+ *               within a few hundredths of a bin with the Hann or Blackman-Harris window
+ *   jain      - magnitude ratio of the peak and its larger neighbour; derived for the
+ *               rectangular window
+ * interpolatePeakQuinn() is Quinn's second estimator. It needs the complex spectrum and,
+ * like Jain's method, assumes a rectangular window, where it is the most accurate of all.
+ */
+
+PeakInterpolation PEAK_INTERPOLATION = PEAK_INTERP_GAUSSIAN;
+const char* const PEAK_INTERPOLATION_NAMES[PEAK_INTERP_COUNT] = {"none", "parabolic", "gaussian", "jain"};
+
+static const float32_t MIN_POWER = 1.0e-30f; // Keeps the logarithms finite on empty bins
+
+static float32_t sqrtOf(const float32_t value)
+{
+    float32_t result = 0.0f;
+    arm_sqrt_f32(value, &result);
+    return result;
+}
+
+SpectralPeak interpolatePeak(const float32_t* pPower, const uint16_t count, const uint32_t peakIdx,
+                             const PeakInterpolation method)
+{
+    SpectralPeak peak = {(float32_t)peakIdx, sqrtOf(pPower[peakIdx])};
+    if (method == PEAK_INTERP_NONE || peakIdx == 0 || peakIdx + 1 >= count)
+    {
+        return peak;
+    }
+
+    switch (method)
+    {
+    case PEAK_INTERP_PARABOLIC:
+        {
+            const float32_t left = sqrtOf(pPower[peakIdx - 1]);
+            const float32_t center = peak.magnitude;
+            const float32_t right = sqrtOf(pPower[peakIdx + 1]);
+            const float32_t denominator = left - 2.0f * center + right;
+            if (denominator < 0.0f)
+            {
+                const float32_t delta = 0.5f * (left - right) / denominator;
+                peak.bin += delta;
+                peak.magnitude = center - 0.25f * (left - right) * delta;
+            }
+            break;
+        }
+    case PEAK_INTERP_GAUSSIAN:
+        {
+            // Log of power is twice the log of magnitude, the offset does not change
+            const float32_t left = logf(pPower[peakIdx - 1] + MIN_POWER);
+            const float32_t center = logf(pPower[peakIdx] + MIN_POWER);
+            const float32_t right = logf(pPower[peakIdx + 1] + MIN_POWER);
+            const float32_t denominator = left - 2.0f * center + right;
+            if (denominator < 0.0f)
+            {
+                const float32_t delta = 0.5f * (left - right) / denominator;
+                peak.bin += delta;
+                peak.magnitude = expf(0.5f * (center - 0.25f * (left - right) * delta));
+            }
+            break;
+        }
+    case PEAK_INTERP_JAIN:
+        {
+            const float32_t left = sqrtOf(pPower[peakIdx - 1]);
+            const float32_t center = peak.magnitude;
+            const float32_t right = sqrtOf(pPower[peakIdx + 1]);
+            if (left > right)
+            {
+                const float32_t ratio = center / left;
+                peak.bin += ratio / (1.0f + ratio) - 1.0f;
+            }
+            else if (center > 0.0f)
+            {
+                const float32_t ratio = right / center;
+                peak.bin += ratio / (1.0f + ratio);
+            }
+            break;
+        }
+    default:
+        break;
+    }
+    return peak;
+}
+
+static float32_t quinnTau(const float32_t x)
+{
+    const float32_t rootTwoThirds = 0.81649658f;
+    return 0.25f * logf(3.0f * x * x + 6.0f * x + 1.0f) -
+        0.10206207f * logf((x + 1.0f - rootTwoThirds) / (x + 1.0f + rootTwoThirds)); // sqrt(6) / 24
+}
+
+/*
+ * pFftOutput is the packed output of arm_rfft_fast_f32(), peakBin is an absolute bin in
+ * 2 .. fftLen / 2 - 2 so both neighbours are ordinary complex bins.
+ */
+SpectralPeak interpolatePeakQuinn(const float32_t* pFftOutput, const uint16_t fftLen, const uint16_t peakBin)
+{
+    const float32_t* pCenter = pFftOutput + 2 * peakBin;
+    const float32_t centerPower = pCenter[0] * pCenter[0] + pCenter[1] * pCenter[1];
+    SpectralPeak peak = {(float32_t)peakBin, sqrtOf(centerPower)};
+    if (peakBin < 2 || peakBin + 2 > fftLen / 2 || centerPower <= 0.0f)
+    {
+        return peak;
+    }
+
+    const float32_t* pLeft = pCenter - 2;
+    const float32_t* pRight = pCenter + 2;
+    const float32_t alphaLeft = (pLeft[0] * pCenter[0] + pLeft[1] * pCenter[1]) / centerPower;
+    const float32_t alphaRight = (pRight[0] * pCenter[0] + pRight[1] * pCenter[1]) / centerPower;
+    const float32_t deltaLeft = alphaLeft / (1.0f - alphaLeft);
+    const float32_t deltaRight = -alphaRight / (1.0f - alphaRight);
+
+    peak.bin += 0.5f * (deltaLeft + deltaRight) + quinnTau(deltaRight * deltaRight) - quinnTau(deltaLeft * deltaLeft);
+    return peak;
+}
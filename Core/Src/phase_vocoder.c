@@ -0,0 +1,139 @@
+#include "phase_vocoder.h"
+#include <string.h>
+
+/*
+ * Frequency refinement from the phase advance of the peak bin between two frames of the
+ * same stream. A stationary partial at k + d bins advances by
+ *     dphi = 2 pi (k + d) H / N
+ * over a hop of H samples, so the measured advance gives d with an error that shrinks as
+ * the hop grows. The window phase term is the same in both frames and cancels.
+ *
+ * The analysis blocks follow each other back to back, or jump after an onset, so the hop
+ * is the difference of their start samples, usually a whole block. dphi is then ambiguous
+ * by multiples of 2 pi; it is unwrapped around the advance predicted from the magnitude
+ * interpolation, which is already within a few hundredths of a bin. A correction larger
+ * than PHASE_VOCODER_MAX_CORRECTION means the partial was not stationary (a note change,
+ * a strong beat) and the magnitude estimate is kept.
+ *
+ * Only PHASE_VOCODER_BINS complex bins around the last fundamental are kept per frame, so
+ * a steady note is refined from its third block on.
+ */
+
+bool PHASE_VOCODER_REFINEMENT = true;
+float32_t PHASE_VOCODER_MAX_CORRECTION = 0.25f;
+
+typedef struct
+{
+    bool isValid;
+    const uint16_t* pAudioHistory;
+    uint16_t fftLen;
+    uint32_t startSample;
+    uint16_t firstBin; // Absolute bin of pBins[0]
+    float32_t pBins[2 * PHASE_VOCODER_BINS];
+} PhaseVocoderFrame;
+
+static PhaseVocoderFrame previousFrame = {0};
+static PhaseVocoderFrame currentFrame = {0};
+static uint32_t candidateBin = 0; // Absolute bin of the last fundamental, 0 when unknown
+
+void resetPhaseVocoder()
+{
+    previousFrame.isValid = false;
+    currentFrame.isValid = false;
+    candidateBin = 0;
+}
+
+/*
+ * Keeps the bins around the last fundamental from pFftOutput, the packed output of
+ * arm_rfft_fast_f32(), and makes the frame before it the previous one.
+ */
+void capturePhaseVocoderFrame(const float32_t* pFftOutput, const SpectrumBand* pBand, const uint16_t* pAudioHistory,
+                              const AudioBlock* pBlock)
+{
+    if (!PHASE_VOCODER_REFINEMENT)
+    {
+        return;
+    }
+
+    previousFrame = currentFrame;
+    currentFrame.isValid = false;
+    if (candidateBin == 0)
+    {
+        return;
+    }
+
+    const uint32_t hop = pBlock->startSample - previousFrame.startSample;
+    if (pBlock->samplesSinceOnset != AUDIO_NO_ONSET && pBlock->samplesSinceOnset < hop)
+    {
+        previousFrame.isValid = false; // The previous frame holds the note before the onset
+    }
+
+    const uint16_t maxFirstBin = pBand->fftLen / 2 - PHASE_VOCODER_BINS;
+    uint32_t firstBin = candidateBin > PHASE_VOCODER_BINS / 2 ? candidateBin - PHASE_VOCODER_BINS / 2 : 1;
+    firstBin = firstBin > 1 ? firstBin : 1; // Bin 0 is packed with the Nyquist value
+    firstBin = firstBin < maxFirstBin ? firstBin : maxFirstBin;
+
+    currentFrame.isValid = true;
+    currentFrame.pAudioHistory = pAudioHistory;
+    currentFrame.fftLen = pBand->fftLen;
+    currentFrame.startSample = pBlock->startSample;
+    currentFrame.firstBin = (uint16_t)firstBin;
+    memcpy(currentFrame.pBins, pFftOutput + 2 * firstBin, sizeof(currentFrame.pBins));
+}
+
+static const float32_t* findFrameBin(const PhaseVocoderFrame* pFrame, const uint32_t bin)
+{
+    if (!pFrame->isValid || bin < pFrame->firstBin || bin >= (uint32_t)pFrame->firstBin + PHASE_VOCODER_BINS)
+    {
+        return NULL;
+    }
+    return pFrame->pBins + 2 * (bin - pFrame->firstBin);
+}
+
+static float32_t wrapPhase(float32_t phase)
+{
+    phase = fmodf(phase + PI, 2.0f * PI);
+    return phase < 0.0f ? phase + PI : phase - PI;
+}
+
+/*
+ * pPeakBin holds the band index of the peak from the magnitude interpolation and is
+ * replaced by the phase estimate when the last two frames allow it. peakIdx is the integer
+ * band index of the peak, remembered as the candidate for the next frame.
+ */
+bool refinePhaseVocoder(const SpectrumBand* pBand, const uint32_t peakIdx, float32_t* pPeakBin)
+{
+    if (!PHASE_VOCODER_REFINEMENT)
+    {
+        return false;
+    }
+
+    const uint32_t peakBin = pBand->firstBin + peakIdx;
+    candidateBin = peakBin;
+
+    const float32_t* pCurrent = findFrameBin(&currentFrame, peakBin);
+    const float32_t* pPrevious = findFrameBin(&previousFrame, peakBin);
+    if (pCurrent == NULL || pPrevious == NULL || currentFrame.fftLen != pBand->fftLen ||
+        previousFrame.fftLen != currentFrame.fftLen || previousFrame.pAudioHistory != currentFrame.pAudioHistory)
+    {
+        return false;
+    }
+    const uint32_t hop = currentFrame.startSample - previousFrame.startSample;
+    if (hop == 0 || hop > 2UL * currentFrame.fftLen)
+    {
+        return false;
+    }
+
+    const float32_t binsPerRadian = (float32_t)currentFrame.fftLen / (2.0f * PI * (float32_t)hop);
+    const float32_t coarseBin = (float32_t)pBand->firstBin + *pPeakBin;
+    const float32_t predictedAdvance = coarseBin / binsPerRadian;
+    const float32_t measuredAdvance = atan2f(pCurrent[1], pCurrent[0]) - atan2f(pPrevious[1], pPrevious[0]);
+    const float32_t correction = wrapPhase(measuredAdvance - predictedAdvance) * binsPerRadian;
+    if (fabsf(correction) > PHASE_VOCODER_MAX_CORRECTION)
+    {
+        return false;
+    }
+
+    *pPeakBin += correction;
+    return true;
+}
@@ -0,0 +1,203 @@
+#include "sample_rate_calibration.h"
+#include <main.h>
+#include "adc_data.h"
+#include "cycle_counter.h"
+#include "uart_log.h"
+
+/*
+ * Measures the real analysis sample rate and publishes it in ADC_SAMPLING_FREQ, the only
+ * rate the pitch math reads. The measurement completes in the ADC interrupt, which only
+ * posts it; applyMeasuredSampleRate() copies it into ADC_SAMPLING_FREQ from the main loop,
+ * the same hand-over as the signal gate, so the rate never changes within an analysis.
+ *
+ * The core clock is first measured against the 32.768 kHz LSE crystal through TIM5
+ * channel 4. Then the ADC interrupt timestamps every DMA chunk with the DWT cycle counter,
+ * and after SAMPLE_RATE_CALIBRATION_CHUNKS chunks the rate is
+ * samples * corrected HCLK / elapsed cycles.
+ *
+ * HCLK and the ADC trigger come from the same oscillator, so the chunk timing alone would
+ * only ever return the nominal rate: the LSE is the independent reference that makes the
+ * measurement mean something. Without it, because SAMPLE_RATE_LSE_REFERENCE is off or the
+ * LSE does not start on the board, the chunks are not timed and ADC_SAMPLING_FREQ keeps
+ * the nominal rate.
+ */
+
+static const float32_t MAX_RATE_DEVIATION = 0.05f; // Reject measurements more than 5% off nominal
+
+volatile float32_t MEASURED_SAMPLING_FREQ = 0.0f;
+float32_t CORE_CLOCK_CORRECTION = 1.0f;
+
+static volatile bool calibrationDone = false;
+static volatile bool isRatePending = false; // MEASURED_SAMPLING_FREQ not yet in ADC_SAMPLING_FREQ
+static volatile bool hasTimingReference = false;
+static bool hasClockReference = false; // CORE_CLOCK_CORRECTION comes from the LSE
+static volatile uint32_t lastChunkCycles = 0;
+static volatile uint32_t timedChunks = 0;
+static volatile uint32_t timedSamples = 0;
+static volatile uint64_t elapsedCycles = 0;
+
+#ifdef SAMPLE_RATE_LSE_REFERENCE
+static const uint32_t LSE_REFERENCE_CAPTURES = 512; // x8 prescaler -> 4096 LSE periods, 125 ms
+
+/*
+ * TIM5 runs from the APB1 timer clock, which is derived from HCLK by an exact prescaler,
+ * so the ratio of measured to nominal timer ticks per LSE period is the HCLK correction.
+ */
+void measureCoreClockCorrection()
+{
+    CORE_CLOCK_CORRECTION = 1.0f;
+    hasClockReference = false;
+
+    RCC_OscInitTypeDef oscInit = {0};
+    HAL_PWR_EnableBkUpAccess();
+    oscInit.OscillatorType = RCC_OSCILLATORTYPE_LSE;
+    oscInit.LSEState = RCC_LSE_ON;
+    oscInit.PLL.PLLState = RCC_PLL_NONE;
+    if (HAL_RCC_OscConfig(&oscInit) != HAL_OK)
+    {
+        #ifdef UART_LOG
+        uartPrintf("LSE did not start, sample rate stays nominal\n\r");
+        #endif // UART_LOG
+        return;
+    }
+
+    __HAL_RCC_TIM5_CLK_ENABLE();
+    TIM_HandleTypeDef htim5 = {0};
+    htim5.Instance = TIM5;
+    htim5.Init.Prescaler = 0;
+    htim5.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim5.Init.Period = 0xFFFFFFFF;
+    htim5.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    HAL_TIM_IC_Init(&htim5);
+
+    TIM_IC_InitTypeDef icConfig = {0};
+    icConfig.ICPolarity = TIM_INPUTCHANNELPOLARITY_RISING;
+    icConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
+    icConfig.ICPrescaler = TIM_ICPSC_DIV8;
+    icConfig.ICFilter = 0;
+    HAL_TIM_IC_ConfigChannel(&htim5, &icConfig, TIM_CHANNEL_4);
+    HAL_TIMEx_RemapConfig(&htim5, TIM_TIM5_LSE);
+    HAL_TIM_IC_Start(&htim5, TIM_CHANNEL_4);
+
+    uint32_t firstCapture = 0;
+    uint32_t lastCapture = 0;
+    for (uint32_t i = 0; i <= LSE_REFERENCE_CAPTURES; i++)
+    {
+        __HAL_TIM_CLEAR_FLAG(&htim5, TIM_FLAG_CC4);
+        while (!__HAL_TIM_GET_FLAG(&htim5, TIM_FLAG_CC4))
+        {
+        }
+        lastCapture = HAL_TIM_ReadCapturedValue(&htim5, TIM_CHANNEL_4);
+        if (i == 0)
+        {
+            firstCapture = lastCapture;
+        }
+    }
+
+    HAL_TIM_IC_Stop(&htim5, TIM_CHANNEL_4);
+    HAL_TIM_IC_DeInit(&htim5);
+    __HAL_RCC_TIM5_CLK_DISABLE();
+
+    const uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    const uint32_t timerFreq = (RCC->CFGR & RCC_CFGR_PPRE1) == RCC_HCLK_DIV1 ? pclk1 : 2 * pclk1;
+    const float32_t referenceSeconds = (float32_t)(LSE_REFERENCE_CAPTURES * 8) / (float32_t)LSE_VALUE;
+    const float32_t measuredTimerFreq = (float32_t)(lastCapture - firstCapture) / referenceSeconds;
+    const float32_t correction = measuredTimerFreq / (float32_t)timerFreq;
+    if (fabsf(correction - 1.0f) >= MAX_RATE_DEVIATION)
+    {
+        #ifdef UART_LOG
+        uartPrintf("Core clock correction %.6f is implausible, sample rate stays nominal\n\r", correction);
+        #endif // UART_LOG
+        return;
+    }
+    CORE_CLOCK_CORRECTION = correction;
+    hasClockReference = true;
+
+    #ifdef UART_LOG
+    uartPrintf("Core clock correction: %.6f\n\r", CORE_CLOCK_CORRECTION);
+    #endif // UART_LOG
+}
+#else
+void measureCoreClockCorrection()
+{
+    CORE_CLOCK_CORRECTION = 1.0f;
+    hasClockReference = false;
+}
+#endif // SAMPLE_RATE_LSE_REFERENCE
+
+void startSampleRateCalibration()
+{
+    enableCycleCounter();
+    calibrationDone = false;
+    isRatePending = false;
+    hasTimingReference = false;
+    timedChunks = 0;
+    timedSamples = 0;
+    elapsedCycles = 0;
+}
+
+/*
+ * Called whenever the chunk stream restarts, so a pause in acquisition is not counted
+ * as chunk time. Chunks timed before the pause are kept.
+ */
+void resetAdcChunkTimingReference()
+{
+    hasTimingReference = false;
+}
+
+static void applyCalibration()
+{
+    const float32_t coreFreq = (float32_t)HAL_RCC_GetHCLKFreq() * CORE_CLOCK_CORRECTION;
+    const float32_t measuredFreq = (float32_t)timedSamples * coreFreq / (float32_t)elapsedCycles;
+
+    if (fabsf(measuredFreq - ADC_SAMPLING_FREQ) < MAX_RATE_DEVIATION * ADC_SAMPLING_FREQ)
+    {
+        MEASURED_SAMPLING_FREQ = measuredFreq;
+        isRatePending = true;
+    }
+    calibrationDone = true;
+}
+
+/*
+ * Called from the main loop, between two analyses.
+ */
+void applyMeasuredSampleRate()
+{
+    if (isRatePending)
+    {
+        isRatePending = false;
+        ADC_SAMPLING_FREQ = MEASURED_SAMPLING_FREQ;
+    }
+}
+
+/*
+ * Called from the ADC interrupt for every DMA chunk. The first chunk after a (re)start
+ * only sets the reference timestamp, so the measurement spans whole chunks.
+ */
+void recordAdcChunkTiming(const uint16_t chunkLength)
+{
+    const uint32_t now = getCycleCount();
+    if (calibrationDone || !hasClockReference)
+    {
+        return;
+    }
+
+    if (hasTimingReference)
+    {
+        elapsedCycles += now - lastChunkCycles;
+        timedSamples += chunkLength;
+        timedChunks++;
+    }
+    lastChunkCycles = now;
+    hasTimingReference = true;
+
+    if (timedChunks >= SAMPLE_RATE_CALIBRATION_CHUNKS)
+    {
+        applyCalibration();
+    }
+}
+
+bool isSampleRateCalibrated()
+{
+    return calibrationDone;
+}
@@ -0,0 +1,85 @@
+#include "signal_gate.h"
+#include "adc_data.h"
+
+/*
+ * Cheap per-block signal statistics, computed in the ADC interrupt and published with the
+ * block they describe. waitForAdcBlock() copies them to SIGNAL_GATE_STATS, so the main
+ * loop reads the statistics of the block it analyses while the interrupt gates the next one.
+ * The main loop skips the whole analysis while the gate is closed.
+ */
+
+SignalGateStats SIGNAL_GATE_STATS = {0};
+float32_t SIGNAL_GATE_OPEN_RMS = 0.01f; // -40 dBFS
+float32_t SIGNAL_GATE_CLOSE_RMS = 0.006f; // ~-44 dBFS
+uint16_t SIGNAL_GATE_CLIP_MARGIN = 2;
+
+static bool isGateOpen = false; // Hysteresis state, follows the last gated block
+
+void calculateSignalStats(const uint16_t* pHistory, const uint32_t startSample, const uint16_t length,
+                          SignalGateStats* pStats)
+{
+    const uint32_t fullScale = (1UL << AUDIO_SAMPLE_BITS) - 1;
+    const uint8_t adcShift = AUDIO_SAMPLE_BITS - 12; // The margin is in converter LSBs, the top code is 4095 << shift
+    const uint32_t clipLow = (uint32_t)SIGNAL_GATE_CLIP_MARGIN << adcShift;
+    const uint32_t clipHigh = ((fullScale >> adcShift) - SIGNAL_GATE_CLIP_MARGIN) << adcShift;
+
+    uint32_t sum = 0;
+    uint64_t sumSq = 0;
+    uint16_t minSample = UINT16_MAX;
+    uint16_t maxSample = 0;
+    uint16_t clipped = 0;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        const uint16_t sample = getAudioSample(pHistory, startSample + i);
+        sum += sample;
+        sumSq += (uint32_t)sample * sample;
+        minSample = sample < minSample ? sample : minSample;
+        maxSample = sample > maxSample ? sample : maxSample;
+        clipped += sample <= clipLow || sample >= clipHigh;
+    }
+
+    // n * sum(x^2) - sum(x)^2 is exact in 64 bits, unlike the float mean of squares
+    const uint64_t scaledVariance = (uint64_t)length * sumSq - (uint64_t)sum * sum;
+    const float32_t variance = (float32_t)scaledVariance / ((float32_t)length * (float32_t)length);
+    const float32_t mean = (float32_t)sum / (float32_t)length;
+    const float32_t halfScale = (float32_t)fullScale / 2.0f;
+
+    float32_t rms = 0.0f;
+    arm_sqrt_f32(variance, &rms);
+    rms /= halfScale;
+
+    const float32_t deviationHigh = (float32_t)maxSample - mean;
+    const float32_t deviationLow = mean - (float32_t)minSample;
+    const float32_t peak = (deviationHigh > deviationLow ? deviationHigh : deviationLow) / halfScale;
+
+    pStats->mean = (uint16_t)(sum / length);
+    pStats->rms = rms;
+    pStats->peak = peak;
+    pStats->clippedSamples = clipped;
+}
+
+void applySignalGate(SignalGateStats* pStats)
+{
+    if (pStats->rms >= SIGNAL_GATE_OPEN_RMS)
+    {
+        isGateOpen = true;
+    }
+    else if (pStats->rms < SIGNAL_GATE_CLOSE_RMS)
+    {
+        isGateOpen = false;
+    }
+    pStats->isOpen = isGateOpen;
+}
+
+/*
+ * Gates a block analysed outside the ADC stream, like the benchmarks, and makes its
+ * statistics those of the block being analysed.
+ */
+void updateSignalGate(const uint16_t* pHistory, const uint32_t startSample, const uint16_t length)
+{
+    SignalGateStats stats = {0};
+    calculateSignalStats(pHistory, startSample, length, &stats);
+    applySignalGate(&stats);
+    SIGNAL_GATE_STATS = stats;
+}
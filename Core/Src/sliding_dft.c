@@ -0,0 +1,239 @@
+#include "sliding_dft.h"
+#include <main.h>
+#include <string.h>
+#include "adc_data.h"
+
+/*
+ * Sliding DFT over a few bins around the last detected peak, so the reading refreshes with
+ * every ADC chunk instead of once per analysis block. Each new sample moves the window of
+ * fftLen samples by one:
+ *     X_k(n) = e^(j 2 pi k / N) (X_k(n - 1) + x[n] - x[n - N])
+ * which keeps X_k referenced to the window start, as the rfft is. Only SLIDING_DFT_MAX_BINS
+ * bins are tracked: every bin costs a complex multiply per sample, so the whole search band
+ * would cost more than the FFT it replaces.
+ *
+ * The recursion has its pole on the unit circle and float rounding accumulates in the
+ * bins. To bound it, a shadow DFT of the next window is accumulated directly, sample by
+ * sample, every SLIDING_DFT_REANCHOR_WINDOWS windows, and replaces the sliding bins when it
+ * is complete. The first shadow window also anchors the bins after startSlidingDft(), so
+ * readings start one window after the start. Spreading the exact DFT over the window keeps
+ * the interrupt time flat.
+ *
+ * The Hann window is applied in the frequency domain,
+ *     X_hann[k] = 0.5 X[k] - 0.25 (X[k - 1] + X[k + 1])
+ * which is why the outermost tracked bins are not returned.
+ */
+
+uint8_t SLIDING_DFT_REANCHOR_WINDOWS = 4;
+
+static volatile bool isSlidingDftActive = false;
+static const uint16_t* pDftHistory = NULL;
+static uint16_t dftLen = 0;
+static uint16_t dftFirstBin = 0;
+static bool isStarting = false; // Next update sets the sample position and starts the first shadow window
+static bool isAnchored = false;
+static uint32_t nextSample = 0;
+static uint16_t shadowSample = 0; // Samples in the shadow window, 0 when no shadow is being built
+static uint16_t chunksSinceAnchor = 0;
+static volatile bool hasUpdate = false;
+
+static float32_t pBins[2 * SLIDING_DFT_MAX_BINS]; // Interleaved complex X_k
+static float32_t pTwiddles[2 * SLIDING_DFT_MAX_BINS]; // e^(j 2 pi k / N)
+static float32_t pShadowBins[2 * SLIDING_DFT_MAX_BINS];
+static float32_t pShadowPhasors[2 * SLIDING_DFT_MAX_BINS]; // e^(-j 2 pi k m / N) for the next shadow sample m
+// New chunk and its x[n] - x[n - N], off the interrupt stack as only the ADC interrupt updates
+static float32_t pChunkSamples[ADC_CHUNK_LEN];
+static float32_t pChunkDiffs[ADC_CHUNK_LEN];
+
+static float32_t getCenteredSample(const uint32_t sampleIdx)
+{
+    const float32_t scale = 2.0f / (float32_t)((1UL << AUDIO_SAMPLE_BITS) - 1);
+    const int32_t midScale = 1L << (AUDIO_SAMPLE_BITS - 1);
+    return (float32_t)((int32_t)getAudioSample(pDftHistory, sampleIdx) - midScale) * scale;
+}
+
+/*
+ * Restarts the engine unless it already tracks the same history, length and bins. Called
+ * after each full analysis, so an unchanged peak costs nothing.
+ */
+void startSlidingDft(const uint16_t* pAudioHistory, const uint16_t fftLen, const float32_t centerFrequency)
+{
+    const int32_t nyquistBin = fftLen / 2;
+    const int32_t centerBin = (int32_t)(centerFrequency * (float32_t)fftLen / ADC_SAMPLING_FREQ + 0.5f);
+    int32_t firstBin = centerBin - SLIDING_DFT_MAX_BINS / 2;
+    firstBin = firstBin + SLIDING_DFT_MAX_BINS > nyquistBin ? nyquistBin - SLIDING_DFT_MAX_BINS : firstBin;
+    firstBin = firstBin > 1 ? firstBin : 1;
+
+    if (isSlidingDftActive && pAudioHistory == pDftHistory && fftLen == dftLen && firstBin == dftFirstBin)
+    {
+        return;
+    }
+
+    isSlidingDftActive = false;
+    pDftHistory = pAudioHistory;
+    dftLen = fftLen;
+    dftFirstBin = (uint16_t)firstBin;
+    for (uint8_t i = 0; i < SLIDING_DFT_MAX_BINS; i++)
+    {
+        const float32_t angle = 2.0f * PI * (float32_t)(firstBin + i) / (float32_t)fftLen;
+        pTwiddles[2 * i] = arm_cos_f32(angle);
+        pTwiddles[2 * i + 1] = arm_sin_f32(angle);
+    }
+    isAnchored = false;
+    hasUpdate = false;
+    isStarting = true;
+    isSlidingDftActive = true;
+}
+
+void stopSlidingDft()
+{
+    isSlidingDftActive = false;
+    hasUpdate = false;
+}
+
+static void startShadowWindow()
+{
+    arm_fill_f32(0.0f, pShadowBins, 2 * SLIDING_DFT_MAX_BINS);
+    for (uint8_t i = 0; i < SLIDING_DFT_MAX_BINS; i++)
+    {
+        pShadowPhasors[2 * i] = 1.0f;
+        pShadowPhasors[2 * i + 1] = 0.0f;
+    }
+    shadowSample = 0;
+}
+
+static void slideBins(const float32_t* pDiffs, const uint16_t length)
+{
+    for (uint8_t i = 0; i < SLIDING_DFT_MAX_BINS; i++)
+    {
+        const float32_t twiddleRe = pTwiddles[2 * i];
+        const float32_t twiddleIm = pTwiddles[2 * i + 1];
+        float32_t binRe = pBins[2 * i];
+        float32_t binIm = pBins[2 * i + 1];
+        for (uint16_t n = 0; n < length; n++)
+        {
+            const float32_t sumRe = binRe + pDiffs[n];
+            binRe = sumRe * twiddleRe - binIm * twiddleIm;
+            binIm = sumRe * twiddleIm + binIm * twiddleRe;
+        }
+        pBins[2 * i] = binRe;
+        pBins[2 * i + 1] = binIm;
+    }
+}
+
+static void accumulateShadow(const float32_t* pSamples, const uint16_t length)
+{
+    for (uint8_t i = 0; i < SLIDING_DFT_MAX_BINS; i++)
+    {
+        // Conjugate twiddle steps the phasor to the next sample
+        const float32_t stepRe = pTwiddles[2 * i];
+        const float32_t stepIm = -pTwiddles[2 * i + 1];
+        float32_t phasorRe = pShadowPhasors[2 * i];
+        float32_t phasorIm = pShadowPhasors[2 * i + 1];
+        float32_t binRe = pShadowBins[2 * i];
+        float32_t binIm = pShadowBins[2 * i + 1];
+        for (uint16_t n = 0; n < length; n++)
+        {
+            binRe += pSamples[n] * phasorRe;
+            binIm += pSamples[n] * phasorIm;
+            const float32_t nextRe = phasorRe * stepRe - phasorIm * stepIm;
+            phasorIm = phasorRe * stepIm + phasorIm * stepRe;
+            phasorRe = nextRe;
+        }
+        pShadowPhasors[2 * i] = phasorRe;
+        pShadowPhasors[2 * i + 1] = phasorIm;
+        pShadowBins[2 * i] = binRe;
+        pShadowBins[2 * i + 1] = binIm;
+    }
+}
+
+/*
+ * Called from the ADC interrupt once the history holds every sample before endSample.
+ * Processes the new samples in one chunk-sized pass.
+ */
+void updateSlidingDft(const uint32_t endSample)
+{
+    if (!isSlidingDftActive)
+    {
+        return;
+    }
+    if (isStarting)
+    {
+        nextSample = endSample;
+        chunksSinceAnchor = 0;
+        startShadowWindow();
+        isAnchored = false;
+        isStarting = false;
+        return;
+    }
+
+    const uint16_t length = (uint16_t)(endSample - nextSample);
+    if (length == 0 || length > ADC_CHUNK_LEN)
+    {
+        isStarting = true; // Lost track of the stream, anchor again
+        hasUpdate = false;
+        return;
+    }
+
+    for (uint16_t n = 0; n < length; n++)
+    {
+        pChunkSamples[n] = getCenteredSample(nextSample + n);
+        pChunkDiffs[n] = pChunkSamples[n] - getCenteredSample(nextSample + n - dftLen);
+    }
+    nextSample = endSample;
+
+    if (isAnchored)
+    {
+        slideBins(pChunkDiffs, length);
+    }
+
+    if (shadowSample < dftLen)
+    {
+        accumulateShadow(pChunkSamples, length);
+        shadowSample += length;
+        if (shadowSample >= dftLen)
+        {
+            memcpy(pBins, pShadowBins, sizeof(pBins));
+            isAnchored = true;
+            chunksSinceAnchor = 0;
+        }
+    }
+    else if (++chunksSinceAnchor * ADC_CHUNK_LEN >= (uint32_t)SLIDING_DFT_REANCHOR_WINDOWS * dftLen)
+    {
+        startShadowWindow();
+    }
+
+    hasUpdate = isAnchored;
+}
+
+/*
+ * Hann-weighted squared magnitudes of the tracked bins, with the band they cover. Returns
+ * false when the bins have not been updated since the previous call.
+ */
+bool takeSlidingDftMagnitudes(float32_t* pBandMag, SpectrumBand* pBand)
+{
+    float32_t pSnapshot[2 * SLIDING_DFT_MAX_BINS];
+    __disable_irq();
+    const bool isReady = hasUpdate;
+    if (isReady)
+    {
+        memcpy(pSnapshot, pBins, sizeof(pSnapshot));
+        pBand->fftLen = dftLen;
+        pBand->firstBin = dftFirstBin + 1;
+        pBand->binCount = SLIDING_DFT_MAX_BINS - 2;
+        hasUpdate = false;
+    }
+    __enable_irq();
+    if (!isReady)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 1; i + 1 < SLIDING_DFT_MAX_BINS; i++)
+    {
+        const float32_t re = 0.5f * pSnapshot[2 * i] - 0.25f * (pSnapshot[2 * i - 2] + pSnapshot[2 * i + 2]);
+        const float32_t im = 0.5f * pSnapshot[2 * i + 1] - 0.25f * (pSnapshot[2 * i - 1] + pSnapshot[2 * i + 3]);
+        pBandMag[i - 1] = re * re + im * im;
+    }
+    return true;
+}
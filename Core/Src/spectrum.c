@@ -0,0 +1,71 @@
+#include "spectrum.h"
+#include "adc_data.h"
+
+/*
+ * Squared magnitudes of the bins between SPECTRUM_MIN_FREQ and SPECTRUM_MAX_FREQ only.
+ * The default band covers A0 to the 4th harmonic of E4 with some margin, about 350 of the
+ * 1024 bins of a 2048-point FFT at 8 kHz.
+ *
+ * arm_rfft_fast_f32() returns fftLen / 2 complex bins, except that bin 0 is packed as
+ * {DC, Nyquist}: both are real, and the Nyquist value takes the place of the DC imaginary
+ * part. Those two bins are unpacked here; every other bin is a plain complex value at
+ * pFftOutput[2 * bin].
+ */
+
+float32_t SPECTRUM_MIN_FREQ = 25.0f;
+float32_t SPECTRUM_MAX_FREQ = 1400.0f;
+
+SpectrumBand getSpectrumBand(const uint16_t fftLen)
+{
+    const float32_t binWidth = ADC_SAMPLING_FREQ / (float32_t)fftLen;
+    const uint16_t nyquistBin = fftLen / 2;
+
+    uint16_t firstBin = (uint16_t)ceilf(SPECTRUM_MIN_FREQ / binWidth);
+    uint16_t lastBin = (uint16_t)floorf(SPECTRUM_MAX_FREQ / binWidth);
+    lastBin = lastBin < nyquistBin ? lastBin : nyquistBin;
+    firstBin = firstBin < lastBin ? firstBin : lastBin;
+
+    const SpectrumBand band = {fftLen, firstBin, (uint16_t)(lastBin - firstBin + 1)};
+    return band;
+}
+
+float32_t calculateBinFrequency(const SpectrumBand* pBand, const float32_t bandIdx)
+{
+    return ((float32_t)pBand->firstBin + bandIdx) * ADC_SAMPLING_FREQ / (float32_t)pBand->fftLen;
+}
+
+void calculateBandMagnitudes(const float32_t* pFftOutput, const SpectrumBand* pBand, float32_t* pBandMag)
+{
+    const uint16_t nyquistBin = pBand->fftLen / 2;
+    uint16_t bin = pBand->firstBin;
+    uint16_t count = pBand->binCount;
+
+    if (count > 0 && bin == 0)
+    {
+        *pBandMag++ = pFftOutput[0] * pFftOutput[0];
+        bin++;
+        count--;
+    }
+    const bool hasNyquist = count > 0 && bin + count - 1 == nyquistBin;
+    if (hasNyquist)
+    {
+        count--;
+    }
+
+    arm_cmplx_mag_squared_f32(pFftOutput + 2 * bin, pBandMag, count);
+
+    if (hasNyquist)
+    {
+        pBandMag[count] = pFftOutput[1] * pFftOutput[1];
+    }
+}
+
+/*
+ * arm_rfft_q15() does not pack: its output holds the full spectrum with DC and Nyquist as
+ * ordinary bins with a zero imaginary part, so the band is a plain slice. Magnitudes come
+ * out in the 3.13 format of arm_cmplx_mag_squared_q15().
+ */
+void calculateBandMagnitudesQ15(const q15_t* pFftOutput, const SpectrumBand* pBand, q15_t* pBandMag)
+{
+    arm_cmplx_mag_squared_q15(pFftOutput + 2 * pBand->firstBin, pBandMag, pBand->binCount);
+}
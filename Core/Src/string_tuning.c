@@ -1,5 +1,12 @@
 #include "string_tuning.h"
 #include "adc_data.h"
+#include "fundamental_estimator.h"
+#include "inharmonicity.h"
+#include "partial_tracker.h"
+#include "peak_interpolation.h"
+#include "phase_vocoder.h"
+#include "time_domain_pitch.h"
+#include "zoom_fft.h"
 #include "ssd1306.h"
 #include "uart_log.h"
 
@@ -14,6 +21,9 @@
  * E: E4 = 329.63 Hz.
  */
 
+GuidedString GUIDED_STRING = GUIDED_STRING_NONE;
+const float32_t GUIDED_STRING_FREQS[GUIDED_STRING_COUNT] = {0.0f, 82.41f, 110.0f, 146.83f, 196.0f, 246.94f, 329.63f};
+
 const char* semitoneNames[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
 
 const float32_t REFERENCE_FREQUENCY = 440.0f; // Frequency of the A4 note
@@ -118,7 +128,7 @@ void detectNote(const float32_t frequency)
     default: ;
     }
 
-    uartPrintf("Note: %s%d (MIDI %d)\n\r", noteNames[noteIndex], octave, roundedNoteNumber);
+    uartPrintf("Note: %s%d (MIDI %d)\n\r", semitoneNames[nearestSemitoneIndex], octave, roundedSemitoneNumber);
     uartPrintf("Detected freq: %.2f Hz\tIdeal freq: %.2f Hz\n\r", frequency, idealFrequency);
     uartPrintf("Diff: %.2f cents\n\r", centsDiff);
     uartPrintf("\n\r");
@@ -155,15 +165,118 @@ float32_t calculateFreqFromFftIndex(const uint16_t size, const float32_t samplin
     return frequency;
 }
 
-void calculateStringTuningInfo(const float32_t* pFftMag, const uint16_t size)
+/*
+ * pBandMag holds the squared magnitudes of the bins in pBand only, so the peak search never
+ * looks outside the configured frequency range. The fundamental bin comes from the partial
+ * tracker while it follows the note, otherwise from FUNDAMENTAL_ESTIMATOR. It is refined to a
+ * fractional bin with PEAK_INTERPOLATION, then by the zoom transform of the block, then from
+ * the phase advance since the previous block when the phase vocoder has both frames. The
+ * result feeds the partial tracker. With INHARMONIC_FIT the f0 fitted to all tracked
+ * partials is shown instead when the fit passes INHARMONIC_MAX_RESIDUAL_CENTS with enough
+ * partials; the estimate carries the fit quality either way.
+ */
+TuningEstimate calculateStringTuningInfo(const float32_t* pBandMag, const SpectrumBand* pBand)
 {
-    float32_t maxMag = 0.0f;
-    uint16_t maxMagIdx = 0;
-    arm_max_f32(pFftMag, size, &maxMag, (uint32_t*)&maxMagIdx);
-    const float32_t maxMagFreq = (float32_t)maxMagIdx * ADC_SAMPLING_FREQ / (float32_t)size;
+    uint32_t maxMagIdx = 0;
+    if (!findTrackedFundamentalBin(pBandMag, pBand, &maxMagIdx))
+    {
+        maxMagIdx = findFundamentalBin(pBandMag, pBand);
+    }
+    const SpectralPeak peak = interpolatePeak(pBandMag, pBand->binCount, maxMagIdx, PEAK_INTERPOLATION);
+    float32_t peakBin = peak.bin;
+    refineZoomFft(pBand, &peakBin);
+    refinePhaseVocoder(pBand, maxMagIdx, &peakBin);
+    const float32_t maxMagFreq = calculateBinFrequency(pBand, peakBin);
+    updatePartialTracks(pBandMag, pBand, maxMagIdx, maxMagFreq);
 
     #ifdef UART_LOG
-    uartPrintf("Idx: %u \t\tMax Frequency: %f\n\r", maxMagIdx, maxMagFreq);
+    uartPrintf("Idx: %lu \t\tMax Frequency: %f\n\r", pBand->firstBin + maxMagIdx, maxMagFreq);
+    #endif // UART_LOG
+    TuningEstimate estimate = {maxMagFreq, maxMagFreq, 0.0f, 0, false};
+    InharmonicFit fit;
+    if (fitInharmonicity(&fit))
+    {
+        estimate.frequency = fit.f0;
+        estimate.residualCents = fit.residualCents;
+        estimate.partialCount = fit.partialCount;
+        estimate.isFitted = true;
+        #ifdef UART_LOG
+        uartPrintf("f0: %f \tB: %.2e \tResidual: %.2f cents, %u partials%s\n\r", fit.f0, fit.b,
+                   fit.residualCents, fit.partialCount, fit.fixedB ? " (stored B)" : "");
+        #endif // UART_LOG
+    }
+    detectNote(estimate.frequency);
+    return estimate;
+}
+
+/*
+ * Peak picking for the FFT_Q15 pipeline, on band magnitudes in 3.13 format.
+ */
+float32_t calculateStringTuningInfoQ15(const q15_t* pBandMag, const SpectrumBand* pBand)
+{
+    const uint32_t maxMagIdx = findFundamentalBinQ15(pBandMag, pBand);
+
+    // Only the peak and its neighbours are needed in float for the sub-bin refinement
+    float32_t pPeakMag[3] = {0.0f, 0.0f, 0.0f};
+    const uint32_t firstIdx = maxMagIdx > 0 ? maxMagIdx - 1 : 0;
+    const uint32_t lastIdx = maxMagIdx + 1 < pBand->binCount ? maxMagIdx + 1 : maxMagIdx;
+    arm_q15_to_float(pBandMag + firstIdx, pPeakMag, lastIdx - firstIdx + 1);
+    const SpectralPeak peak = interpolatePeak(pPeakMag, lastIdx - firstIdx + 1, maxMagIdx - firstIdx,
+                                              PEAK_INTERPOLATION);
+    const float32_t maxMagFreq = calculateBinFrequency(pBand, (float32_t)firstIdx + peak.bin);
+
+    #ifdef UART_LOG
+    uartPrintf("Idx: %lu \t\tMax Frequency: %f\n\r", pBand->firstBin + maxMagIdx, maxMagFreq);
     #endif // UART_LOG
     detectNote(maxMagFreq);
+    return maxMagFreq;
+}
+
+/*
+ * Time-domain alternative to the spectrum peak, selected with PITCH_DETECTOR. pSamples holds
+ * the unwindowed block and, like pWork, is overwritten.
+ */
+float32_t calculateStringTuningInfoTimeDomain(const arm_rfft_fast_instance_f32* pFftInstance, float32_t* pSamples,
+                                              float32_t* pWork, const uint16_t len)
+{
+    const float32_t frequency = estimateTimeDomainPitch(pFftInstance, PITCH_DETECTOR, pSamples, pWork, len);
+
+    #ifdef UART_LOG
+    uartPrintf("Detector: %s \t\tFrequency: %f\n\r", PITCH_DETECTOR_NAMES[PITCH_DETECTOR], frequency);
+    #endif // UART_LOG
+    detectNote(frequency);
+    return frequency;
+}
+
+/*
+ * Single-string mode: the pitch comes from the Goertzel bank around the GUIDED_STRING
+ * target instead of a spectrum or autocorrelation of the block.
+ */
+float32_t calculateStringTuningInfoGuided(const GoertzelResult* pResult)
+{
+    #ifdef UART_LOG
+    uartPrintf("Target: %.2f Hz \t\tDeviation: %.1f cents%s\n\r", pResult->targetFrequency, pResult->centsDeviation,
+               pResult->isInRange ? "" : " (out of range)");
+    #endif // UART_LOG
+    detectNote(pResult->frequency);
+    return pResult->frequency;
+}
+
+/*
+ * Reading between analysis blocks from the sliding DFT bins. The band is only a few bins
+ * around the last fundamental, so the strongest bin is taken without the harmonic search.
+ */
+float32_t calculateStringTuningInfoSliding(const float32_t* pBandMag, const SpectrumBand* pBand)
+{
+    float32_t maxMag = 0.0f;
+    uint32_t maxMagIdx = 0;
+    arm_max_f32(pBandMag, pBand->binCount, &maxMag, &maxMagIdx);
+    const SpectralPeak peak = interpolatePeak(pBandMag, pBand->binCount, maxMagIdx, PEAK_INTERPOLATION);
+    const float32_t frequency = calculateBinFrequency(pBand, peak.bin);
+
+    #ifdef UART_LOG
+    uartPrintf("Sliding DFT frequency: %f\n\r", frequency);
+    #endif // UART_LOG
+    detectNote(frequency);
+    return frequency;
 }
@@ -0,0 +1,249 @@
+#include "time_domain_pitch.h"
+
+#include <stdbool.h>
+#include "adc_data.h"
+#include "spectrum.h"
+#include "window.h"
+
+/*
+ * Period estimators working on the autocorrelation or the cepstrum instead of the spectrum
+ * peak. All are robust to a weak fundamental because the full period of a harmonic tone
+ * repeats even when most of its energy is in the 2nd or 3rd harmonic.
+ *
+ * The autocorrelation comes from the same rfft as the spectrum path: the block is zero
+ * padded by maxLag samples so the circular correlation does not wrap, transformed, turned
+ * into the power spectrum in place and transformed back. For lags up to maxLag
+ *     r(tau) = sum x[j] x[j + tau]
+ *     m(tau) = sum x[j]^2 + x[j + tau]^2
+ * over the D - tau pairs inside the D = len - maxLag data samples. m(tau) is the block
+ * energy minus the tau samples dropped at each end, so it is updated per lag.
+ *
+ *   YIN    - difference d(tau) = m(tau) - 2 r(tau), cumulative mean normalised, the first
+ *            dip below YIN_THRESHOLD is the period (de Cheveigne and Kawahara)
+ *   McLeod - NSDF n(tau) = 2 r(tau) / m(tau), the first key maximum above
+ *            MCLEOD_PEAK_RATIO of the highest is the period (McLeod and Wyvill)
+ *
+ * The cepstrum takes the same rfft the other way: the Hann-windowed block is transformed,
+ * its log power spectrum is put back in the packed layout as a real, even spectrum and
+ * transformed back. The harmonics are a comb with the spacing f0 in the log spectrum, so
+ * the real cepstrum peaks at the quefrency of the period whether or not the fundamental
+ * itself is present, and the log keeps one strong partial from dominating the comb. The
+ * power is floored at CEPSTRUM_POWER_FLOOR of the strongest bin first, so the empty bins
+ * between the partials do not turn into deep log notches. The highest cepstrum value in the
+ * lag range is the period. Its peak is only a few samples wide, so the estimate is a few
+ * cents coarser than YIN or McLeod; the gain is an octave-safe reading of sparse spectra.
+ *
+ * Every lag is refined with a parabola through its neighbours. Lags are limited to the
+ * SPECTRUM_MIN_FREQ .. SPECTRUM_MAX_FREQ range and to half the block.
+ */
+
+PitchDetector PITCH_DETECTOR = PITCH_DETECTOR_SPECTRUM;
+const char* const PITCH_DETECTOR_NAMES[PITCH_DETECTOR_COUNT] = {"spectrum", "yin", "mcleod", "cepstrum"};
+float32_t YIN_THRESHOLD = 0.15f;
+float32_t MCLEOD_PEAK_RATIO = 0.9f;
+float32_t CEPSTRUM_POWER_FLOOR = 1e-6f; // -60 dB
+
+static float32_t pLagValues[PITCH_MAX_LAG + 1]; // m(tau), then the YIN or NSDF value per lag
+
+static float32_t refineLag(const float32_t* pValues, const uint16_t lag, const uint16_t maxLag)
+{
+    if (lag == 0 || lag >= maxLag)
+    {
+        return (float32_t)lag;
+    }
+    const float32_t left = pValues[lag - 1];
+    const float32_t center = pValues[lag];
+    const float32_t right = pValues[lag + 1];
+    const float32_t denominator = left - 2.0f * center + right;
+    if (denominator == 0.0f)
+    {
+        return (float32_t)lag;
+    }
+    return (float32_t)lag + 0.5f * (left - right) / denominator;
+}
+
+/*
+ * pLagValues holds m(tau) and pCorrelation r(tau) on entry.
+ */
+static float32_t findYinLag(const float32_t* pCorrelation, const uint16_t minLag, const uint16_t maxLag)
+{
+    float32_t runningSum = 0.0f;
+    pLagValues[0] = 1.0f;
+    for (uint16_t lag = 1; lag <= maxLag; lag++)
+    {
+        const float32_t difference = pLagValues[lag] - 2.0f * pCorrelation[lag];
+        runningSum += difference;
+        pLagValues[lag] = runningSum > 0.0f ? difference * (float32_t)lag / runningSum : 1.0f;
+    }
+
+    for (uint16_t lag = minLag; lag < maxLag; lag++)
+    {
+        if (pLagValues[lag] < YIN_THRESHOLD)
+        {
+            while (lag + 1 < maxLag && pLagValues[lag + 1] < pLagValues[lag])
+            {
+                lag++;
+            }
+            return refineLag(pLagValues, lag, maxLag);
+        }
+    }
+    return 0.0f; // Aperiodic
+}
+
+static float32_t findMcleodLag(const float32_t* pCorrelation, const uint16_t minLag, const uint16_t maxLag)
+{
+    for (uint16_t lag = 0; lag <= maxLag; lag++)
+    {
+        pLagValues[lag] = pLagValues[lag] > 0.0f ? 2.0f * pCorrelation[lag] / pLagValues[lag] : 0.0f;
+    }
+
+    // Key maxima are the highest points between a rising and the next falling zero crossing
+    float32_t highestPeak = 0.0f;
+    for (uint16_t pass = 0; pass < 2; pass++)
+    {
+        bool isPositive = false;
+        uint16_t peakLag = 0;
+        for (uint16_t lag = 1; lag <= maxLag; lag++)
+        {
+            const float32_t value = pLagValues[lag];
+            if (!isPositive && value > 0.0f && pLagValues[lag - 1] <= 0.0f)
+            {
+                isPositive = true;
+                peakLag = lag;
+            }
+            if (!isPositive)
+            {
+                continue;
+            }
+            if (value > pLagValues[peakLag])
+            {
+                peakLag = lag;
+            }
+            if (value <= 0.0f || lag == maxLag)
+            {
+                isPositive = false;
+                const float32_t peak = pLagValues[peakLag];
+                if (peakLag < minLag || peakLag >= maxLag)
+                {
+                    continue;
+                }
+                if (pass == 0 && peak > highestPeak)
+                {
+                    highestPeak = peak;
+                }
+                else if (pass == 1 && peak >= MCLEOD_PEAK_RATIO * highestPeak)
+                {
+                    return refineLag(pLagValues, peakLag, maxLag);
+                }
+            }
+        }
+        if (highestPeak <= 0.0f)
+        {
+            break;
+        }
+    }
+    return 0.0f; // No positive correlation beyond the first zero crossing
+}
+
+/*
+ * Real cepstrum of the block in pSamples, with pWork as the spectrum buffer.
+ */
+static float32_t findCepstrumLag(const arm_rfft_fast_instance_f32* pFftInstance, float32_t* pSamples,
+                                 float32_t* pWork, const uint16_t len, const uint16_t minLag, const uint16_t maxLag)
+{
+    const float32_t* pWindow = getWindowTable(WINDOW_HANN, len);
+    if (pWindow != NULL)
+    {
+        for (uint16_t i = 0; i < len; i++)
+        {
+            pSamples[i] *= pWindow[getWindowTableIdx(i, len)];
+        }
+    }
+    arm_rfft_fast_f32(pFftInstance, pSamples, pWork, 0);
+
+    // Power of bins 0..len / 2 in a row, for the vector log
+    const uint16_t nyquistBin = len / 2;
+    pSamples[0] = pWork[0] * pWork[0];
+    pSamples[nyquistBin] = pWork[1] * pWork[1];
+    arm_cmplx_mag_squared_f32(pWork + 2, pSamples + 1, nyquistBin - 1);
+    float32_t maxPower = 0.0f;
+    uint32_t maxPowerIdx = 0;
+    arm_max_f32(pSamples, nyquistBin + 1, &maxPower, &maxPowerIdx);
+    if (maxPower <= 0.0f)
+    {
+        return 0.0f; // Silent block
+    }
+    arm_offset_f32(pSamples, maxPower * CEPSTRUM_POWER_FLOOR, pSamples, nyquistBin + 1);
+    arm_vlog_f32(pSamples, pSamples, nyquistBin + 1);
+
+    pWork[0] = pSamples[0];
+    pWork[1] = pSamples[nyquistBin];
+    for (uint16_t bin = 1; bin < nyquistBin; bin++)
+    {
+        pWork[2 * bin] = pSamples[bin];
+        pWork[2 * bin + 1] = 0.0f;
+    }
+    arm_rfft_fast_f32(pFftInstance, pWork, pSamples, 1);
+
+    float32_t peak = 0.0f;
+    uint32_t peakIdx = 0;
+    arm_max_f32(pSamples + minLag, maxLag - minLag + 1, &peak, &peakIdx);
+    if (peak <= 0.0f)
+    {
+        return 0.0f; // No harmonic comb
+    }
+    return refineLag(pSamples, (uint16_t)(minLag + peakIdx), maxLag);
+}
+
+/*
+ * pSamples holds len unwindowed samples and is used as scratch, pWork needs len floats too.
+ * pFftInstance must be initialised for len. Returns the frequency in Hz, or 0 when the
+ * block has no detectable period.
+ */
+float32_t estimateTimeDomainPitch(const arm_rfft_fast_instance_f32* pFftInstance, const PitchDetector detector,
+                                  float32_t* pSamples, float32_t* pWork, const uint16_t len)
+{
+    uint16_t maxLag = (uint16_t)(ADC_SAMPLING_FREQ / SPECTRUM_MIN_FREQ);
+    maxLag = maxLag < len / 2 ? maxLag : len / 2;
+    maxLag = maxLag < PITCH_MAX_LAG ? maxLag : PITCH_MAX_LAG;
+    uint16_t minLag = (uint16_t)(ADC_SAMPLING_FREQ / SPECTRUM_MAX_FREQ);
+    minLag = minLag > 2 ? minLag : 2;
+    if (detector == PITCH_DETECTOR_CEPSTRUM)
+    {
+        const float32_t lag = findCepstrumLag(pFftInstance, pSamples, pWork, len, minLag, maxLag);
+        return lag > 0.0f ? ADC_SAMPLING_FREQ / lag : 0.0f;
+    }
+
+    const uint16_t dataLen = len - maxLag;
+
+    arm_fill_f32(0.0f, pSamples + dataLen, maxLag);
+    float32_t energy = 0.0f;
+    arm_dot_prod_f32(pSamples, pSamples, dataLen, &energy);
+    float32_t sumSquares = 2.0f * energy;
+    for (uint16_t lag = 0; lag <= maxLag; lag++)
+    {
+        pLagValues[lag] = sumSquares;
+        if (lag < maxLag)
+        {
+            const float32_t head = pSamples[lag];
+            const float32_t tail = pSamples[dataLen - 1 - lag];
+            sumSquares -= head * head + tail * tail;
+        }
+    }
+
+    arm_rfft_fast_f32(pFftInstance, pSamples, pWork, 0);
+    // Power spectrum in the packed layout: bin 0 holds the real DC and Nyquist values
+    pWork[0] *= pWork[0];
+    pWork[1] *= pWork[1];
+    for (uint16_t i = 2; i < len; i += 2)
+    {
+        pWork[i] = pWork[i] * pWork[i] + pWork[i + 1] * pWork[i + 1];
+        pWork[i + 1] = 0.0f;
+    }
+    arm_rfft_fast_f32(pFftInstance, pWork, pSamples, 1);
+
+    const float32_t lag = detector == PITCH_DETECTOR_YIN
+                              ? findYinLag(pSamples, minLag, maxLag)
+                              : findMcleodLag(pSamples, minLag, maxLag);
+    return lag > 0.0f ? ADC_SAMPLING_FREQ / lag : 0.0f;
+}
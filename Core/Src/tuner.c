@@ -5,8 +5,43 @@
 #include <stdio.h>
 #include "arm_math.h"
 #include "adc_data.h"
+#include "analysis_length.h"
+#include "decimation_pyramid.h"
+#include "normalization.h"
+#include "partial_tracker.h"
+#include "phase_vocoder.h"
 #include "string_tuning.h"
+#include "sample_rate_calibration.h"
+#include "signal_gate.h"
+#include "sliding_dft.h"
+#include "spectrum.h"
+#include "goertzel_bank.h"
 #include "ssd1306.h"
+#include "time_domain_pitch.h"
+#include "zoom_fft.h"
+#ifdef BENCHMARK
+#include "benchmark.h"
+#endif // BENCHMARK
+
+static const uint16_t IDLE_AFTER_SILENT_BLOCKS = 8; // Closed-gate blocks before switching to waitForPluck()
+
+/*
+ * Work buffers of the analysis of one block, sized for AUDIO_MAX_DATA_LEN. Static so the
+ * linker accounts for them, instead of 2 * fftLen floats of stack per call.
+ */
+static union
+{
+    float32_t f32[2 * AUDIO_MAX_DATA_LEN]; // Input, then output of the float rfft
+    q15_t q15[3 * AUDIO_MAX_DATA_LEN]; // Input, then 2 * fftLen output of the q15 rfft
+} fftScratch;
+
+// Buffers of main() for the life of the program, static for the same reason
+static uint16_t pAudioHistory[AUDIO_HISTORY_LEN * AUDIO_INPUT_COUNT];
+#ifdef FFT_Q15
+static q15_t pBandMag[AUDIO_MAX_DATA_LEN / 2 + 1];
+#else
+static float32_t pBandMag[AUDIO_MAX_DATA_LEN / 2 + 1];
+#endif // FFT_Q15
 
 void blinkTimesWithDelay(const int times, const int delay)
 {
@@ -22,12 +57,20 @@ bool isWakedUpFromStandby()
     return __HAL_PWR_GET_FLAG(PWR_FLAG_WU);
 }
 
-void fft(const arm_rfft_fast_instance_f32* pFftInstance, const uint16_t* pAudioData, float32_t* pFftOutputMag);
+void fft(const arm_rfft_fast_instance_f32* pFftInstance, const uint16_t* pAudioHistory, const AudioBlock* pBlock,
+         const SpectrumBand* pBand, float32_t* pBandMag);
+void fftQ15(const arm_rfft_instance_q15* pFftInstance, const uint16_t* pAudioHistory, const AudioBlock* pBlock,
+            const SpectrumBand* pBand, q15_t* pBandMag);
+void pyramidFft(const arm_rfft_fast_instance_f32* pFftInstance, const PyramidBlock* pBlock, const SpectrumBand* pBand,
+                float32_t* pBandMag);
+float32_t timeDomainPitch(const arm_rfft_fast_instance_f32* pFftInstance, const uint16_t* pAudioHistory,
+                          const AudioBlock* pBlock);
+void startGuidedTuning(GuidedString guidedString);
+void refreshFromSlidingDft();
 void showInfo();
-void normalize(const uint16_t* src, float32_t* dst, size_t len);
 
 #ifdef UART_DEBUG_ARRAYS
-static void logAudioData(const uint16_t* pAudioData, const uint16_t size)
+static void logAudioData(const uint16_t* pAudioHistory, const uint32_t startSample, const uint16_t size)
 {
     uartPrintf("pAudioData[idx]:\n\r");
     const uint16_t blockSize = 32;
@@ -38,7 +81,7 @@ static void logAudioData(const uint16_t* pAudioData, const uint16_t size)
 
         for (uint16_t j = i; j <= blockEnd; j++)
         {
-            uartPrintf("%5u ", pAudioData[j]);
+            uartPrintf("%5u ", getAudioSample(pAudioHistory, startSample + j));
         }
 
         uartPrintf("\n\r");
@@ -84,9 +127,10 @@ static void logFftOutput(const float32_t* pFftOutput, const uint16_t size)
     uartPrintf("\n\r");
 }
 
-static void logFftOutputMag(const float32_t* pFftOutputMag, const uint16_t size)
+static void logBandMag(const float32_t* pBandMag, const SpectrumBand* pBand)
 {
-    uartPrintf("pFftOutputMag[idx]:\n\r");
+    uartPrintf("pBandMag[idx]:\n\r");
+    const uint16_t size = pBand->binCount;
     const uint16_t blockSize = 8;
     for (uint16_t i = 0; i < size; i += blockSize)
     {
@@ -95,8 +139,8 @@ static void logFftOutputMag(const float32_t* pFftOutputMag, const uint16_t size)
 
         for (uint16_t j = i; j <= blockEnd; j++)
         {
-            const float32_t freq = calculateFreqFromFftIndex(size, ADC_SAMPLING_FREQ, j);
-            uartPrintf("%6.1fHz: %6.2f | ", freq, pFftOutputMag[j]);
+            const float32_t freq = calculateBinFrequency(pBand, (float32_t)j);
+            uartPrintf("%6.1fHz: %6.2f | ", freq, pBandMag[j]);
         }
 
         uartPrintf("\n\r");
@@ -112,12 +156,17 @@ int main(void)
     MxDmaInit();
     MxGpioInit();
     MxAdcInit();
+    MxTimInit();
     MxI2cInit();
 
     #ifdef UART
     MxUartInit();
     #endif // UART
 
+    #ifdef BENCHMARK
+    runBenchmarks(pAudioHistory, fftScratch.f32, fftScratch.q15);
+    #endif // BENCHMARK
+
     if (isWakedUpFromStandby())
     {
         __HAL_PWR_CLEAR_FLAG(PWR_FLAG_SB);
@@ -171,31 +220,149 @@ int main(void)
     ssd1306_SetColor(White);
     ssd1306_UpdateScreen();
 
-    uint16_t pAudioData[AUDIO_DATA_LEN];
-    float32_t pFftOutputMag[AUDIO_DATA_LEN];
-
-    arm_rfft_fast_instance_f32 fftInstance;
-    arm_rfft_fast_init_f32(&fftInstance, AUDIO_DATA_LEN);
+    #ifdef FFT_Q15
+    arm_rfft_instance_q15 pFftInstances[ANALYSIS_LEN_COUNT];
+    for (AnalysisLength mode = ANALYSIS_LEN_512; mode < ANALYSIS_LEN_COUNT; mode++)
+    {
+        arm_rfft_init_q15(&pFftInstances[mode], ANALYSIS_LEN_TABLE[mode], 0, 1);
+    }
+    #else
+    arm_rfft_fast_instance_f32 pFftInstances[ANALYSIS_LEN_COUNT];
+    for (AnalysisLength mode = ANALYSIS_LEN_512; mode < ANALYSIS_LEN_COUNT; mode++)
+    {
+        arm_rfft_fast_init_f32(&pFftInstances[mode], ANALYSIS_LEN_TABLE[mode]);
+    }
+    #endif // FFT_Q15
 
     #ifdef UART
     uartClearTerminal();
     #endif // UART
 
+    measureCoreClockCorrection();
+    #ifdef ADC_OVERSAMPLING
+    setAdcSampleRate(ADC_RATE_32KHZ);
+    #else
+    setAdcSampleRate(ADC_RATE_8KHZ);
+    #endif // ADC_OVERSAMPLING
+    GuidedString guidedString = GUIDED_STRING;
+    startGuidedTuning(guidedString);
+    startAdcRingRecording(pAudioHistory, ANALYSIS_LEN_TABLE[ANALYSIS_LEN_DEFAULT]);
+
+    uint16_t silentBlocks = 0;
+    float32_t lastFrequency = 0.0f;
+
     while (1)
     {
         #ifdef UART_DEBUG
         uartClearTerminal();
         #endif // UART_DEBUG
-        startAdcDataRecording(pAudioData, AUDIO_DATA_LEN);
-        ssd1306_UpdateScreen();
-        waitForOledReadiness();
-        ssd1306_Clear();
-        waitForAdcData();
+        #ifdef SLIDING_DFT
+        refreshFromSlidingDft();
+        #endif // SLIDING_DFT
+        const AudioBlock audioBlock = waitForAdcBlock();
+        #ifdef UART_LOG
+        if (audioBlock.samplesSinceOnset != AUDIO_NO_ONSET)
+        {
+            uartPrintf("Block starts %.1f ms after onset\n\r",
+                       (float32_t)audioBlock.samplesSinceOnset * 1000.0f / ADC_SAMPLING_FREQ);
+        }
+        uartPrintf("Gate: %s, rms %.4f, peak %.4f, clipped %u\n\r", audioBlock.gate.isOpen ? "open" : "closed",
+                   audioBlock.gate.rms, audioBlock.gate.peak, audioBlock.gate.clippedSamples);
+        #endif // UART_LOG
+        if (!audioBlock.gate.isOpen)
+        {
+            #ifdef SLIDING_DFT
+            stopSlidingDft();
+            #endif // SLIDING_DFT
+            resetPhaseVocoder();
+            resetPartialTracker();
+            lastFrequency = 0.0f;
+            setAdcBlockLength(ANALYSIS_LEN_TABLE[ANALYSIS_LEN_DEFAULT]);
+            if (++silentBlocks >= IDLE_AFTER_SILENT_BLOCKS)
+            {
+                const uint16_t adcBias = audioBlock.gate.mean >> (AUDIO_SAMPLE_BITS - 12);
+                stopAdcRingRecording();
+                waitForPluck(adcBias);
+                startGuidedTuning(guidedString);
+                startAdcRingRecording(pAudioHistory, ANALYSIS_LEN_TABLE[ANALYSIS_LEN_DEFAULT]);
+                resetDcBlocker();
+                silentBlocks = 0;
+            }
+            continue; // Nothing to analyse: keep the last reading on screen and go back to sleep
+        }
+        silentBlocks = 0;
+        if (GUIDED_STRING != guidedString)
+        {
+            guidedString = GUIDED_STRING;
+            startGuidedTuning(guidedString);
+        }
+        if (guidedString != GUIDED_STRING_NONE)
+        {
+            // The bank runs in the ADC interrupt, the block only paces the display
+            GoertzelResult guidedResult;
+            if (takeGoertzelResult(&guidedResult))
+            {
+                waitForOledReadiness();
+                ssd1306_Clear();
+                lastFrequency = calculateStringTuningInfoGuided(&guidedResult);
+                ssd1306_UpdateScreen();
+            }
+            continue;
+        }
+        const uint16_t* pInputHistory = pAudioHistory + audioBlock.input;
+        startPartialFrame(&audioBlock);
+        #if defined(DUAL_INPUT) && defined(UART_LOG)
+        uartPrintf("Input: %u\n\r", audioBlock.input);
+        #endif
         #ifdef UART_DEBUG_ARRAYS
-        logAudioData(pAudioData, AUDIO_DATA_LEN);
+        logAudioData(pInputHistory, audioBlock.startSample, audioBlock.length);
         #endif // UART_DEBUG_ARRAYS
-        fft(&fftInstance, pAudioData, pFftOutputMag);
-        calculateStringTuningInfo(pFftOutputMag, AUDIO_DATA_LEN);
+        const AnalysisLength analysisLength = findAnalysisLength(audioBlock.length);
+        const SpectrumBand band = getSpectrumBand(audioBlock.length);
+        #ifdef FFT_Q15
+        fftQ15(&pFftInstances[analysisLength], pInputHistory, &audioBlock, &band, pBandMag);
+        waitForOledReadiness();
+        ssd1306_Clear();
+        lastFrequency = calculateStringTuningInfoQ15(pBandMag, &band);
+        #else
+        #ifdef DECIMATION_PYRAMID
+        const PyramidBlock pyramidBlock = choosePyramidBlock(lastFrequency, &audioBlock);
+        #else
+        const PyramidBlock pyramidBlock = {0};
+        #endif // DECIMATION_PYRAMID
+        if (PITCH_DETECTOR == PITCH_DETECTOR_SPECTRUM && pyramidBlock.length > 0)
+        {
+            const SpectrumBand pyramidBand = getPyramidBand(&pyramidBlock);
+            pyramidFft(&pFftInstances[findAnalysisLength(pyramidBlock.length)], &pyramidBlock, &pyramidBand,
+                       pBandMag);
+            waitForOledReadiness();
+            ssd1306_Clear();
+            lastFrequency = calculateStringTuningInfo(pBandMag, &pyramidBand).frequency;
+        }
+        else if (PITCH_DETECTOR == PITCH_DETECTOR_SPECTRUM)
+        {
+            fft(&pFftInstances[analysisLength], pInputHistory, &audioBlock, &band, pBandMag);
+            waitForOledReadiness();
+            ssd1306_Clear();
+            lastFrequency = calculateStringTuningInfo(pBandMag, &band).frequency;
+        }
+        else
+        {
+            lastFrequency = timeDomainPitch(&pFftInstances[analysisLength], pInputHistory, &audioBlock);
+        }
+        #endif // FFT_Q15
+        ssd1306_UpdateScreen();
+        #ifdef SLIDING_DFT
+        if (lastFrequency > 0.0f)
+        {
+            startSlidingDft(pInputHistory, audioBlock.length, lastFrequency);
+        }
+        else
+        {
+            stopSlidingDft();
+        }
+        #endif // SLIDING_DFT
+        setAdcBlockLength(ANALYSIS_LEN_TABLE[chooseAnalysisLength(lastFrequency)]);
         // showInfo();
         #ifdef UART_DEBUG
         HAL_Delay(5000);
@@ -203,54 +370,127 @@ int main(void)
     }
 }
 
-void fft(const arm_rfft_fast_instance_f32* pFftInstance, const uint16_t* pAudioData, float32_t* pFftOutputMag)
+void fft(const arm_rfft_fast_instance_f32* pFftInstance, const uint16_t* pAudioHistory, const AudioBlock* pBlock,
+         const SpectrumBand* pBand, float32_t* pBandMag)
 {
     // HAL_GPIO_WritePin(LED_GPIO_Port, LED_Pin, !HAL_GPIO_ReadPin(LED_GPIO_Port, LED_Pin));
-    AUDIO_DATA_IS_ACTUAL = false;
-    float32_t pAudioDataNormalized[AUDIO_DATA_LEN];
-    float32_t pFftOutput[AUDIO_DATA_LEN];
-    normalize(pAudioData, pAudioDataNormalized, AUDIO_DATA_LEN);
+    const uint16_t fftLen = pBlock->length;
+    float32_t* pAudioDataNormalized = fftScratch.f32;
+    float32_t* pFftOutput = fftScratch.f32 + AUDIO_MAX_DATA_LEN;
+    normalize(pAudioHistory, pBlock->startSample, pAudioDataNormalized, fftLen);
     #ifdef UART_DEBUG_ARRAYS
-    logNormalizedAudioData(pAudioDataNormalized, AUDIO_DATA_LEN);
+    logNormalizedAudioData(pAudioDataNormalized, fftLen);
     #endif // UART_DEBUG_ARRAYS
     arm_rfft_fast_f32(pFftInstance, pAudioDataNormalized, pFftOutput, 0);
     #ifdef UART_DEBUG_ARRAYS
-    logFftOutput(pFftOutput, AUDIO_DATA_LEN);
+    logFftOutput(pFftOutput, fftLen);
     #endif // UART_DEBUG_ARRAYS
-    arm_cmplx_mag_squared_f32(pFftOutput, pFftOutputMag, AUDIO_DATA_LEN);
+    calculateBandMagnitudes(pFftOutput, pBand, pBandMag);
+    capturePhaseVocoderFrame(pFftOutput, pBand, pAudioHistory, pBlock);
+    captureZoomBlock(pAudioHistory, pBlock);
     #ifdef UART_DEBUG_ARRAYS
-    logFftOutputMag(pFftOutputMag, AUDIO_DATA_LEN);
+    logBandMag(pBandMag, pBand);
     #endif // UART_DEBUG_ARRAYS
 }
 
-void showInfo()
+/*
+ * fft() of a block of the decimation pyramid. The zoom transform and the phase vocoder work
+ * on full-rate blocks, so their state is dropped and the reading is the interpolated peak.
+ */
+void pyramidFft(const arm_rfft_fast_instance_f32* pFftInstance, const PyramidBlock* pBlock, const SpectrumBand* pBand,
+                float32_t* pBandMag)
 {
+    float32_t* pAudioDataNormalized = fftScratch.f32;
+    float32_t* pFftOutput = fftScratch.f32 + AUDIO_MAX_DATA_LEN;
+    readPyramidBlock(pBlock, pAudioDataNormalized, ANALYSIS_WINDOW);
+    arm_rfft_fast_f32(pFftInstance, pAudioDataNormalized, pFftOutput, 0);
+    calculateBandMagnitudes(pFftOutput, pBand, pBandMag);
+    resetPhaseVocoder();
+    resetZoomFft();
     #ifdef UART_LOG
-    uartPrintf("Tuning info: empty\n\n\r");
+    uartPrintf("Pyramid level %u: %u samples at %.0f Hz\n\r", pBlock->level, pBlock->length,
+               ADC_SAMPLING_FREQ / (float32_t)(1U << pBlock->level));
     #endif // UART_LOG
 }
 
-void normalize(const uint16_t* src, float32_t* dst, const size_t len)
+/*
+ * Fixed-point variant of fft(). The rfft works in place on its input and needs an output of
+ * 2 * fftLen q15, 12 KB for 2048 samples against 16 KB for the float path.
+ */
+void fftQ15(const arm_rfft_instance_q15* pFftInstance, const uint16_t* pAudioHistory, const AudioBlock* pBlock,
+            const SpectrumBand* pBand, q15_t* pBandMag)
 {
-    const uint16_t ADC_BITS = 12;
-    const uint16_t ADC_MAX = (1 << ADC_BITS) - 1; // 4095
-    const float32_t ADC_CENTER = (float32_t)ADC_MAX / 2.0f; // 2047.5
-    const float32_t ADC_SCALE = ADC_CENTER;
+    const uint16_t fftLen = pBlock->length;
+    q15_t* pAudioDataNormalized = fftScratch.q15;
+    q15_t* pFftOutput = fftScratch.q15 + AUDIO_MAX_DATA_LEN;
+    const uint8_t gainShift = normalizeQ15(pAudioHistory, pBlock->startSample, pAudioDataNormalized, fftLen);
+    #ifdef UART_DEBUG
+    uartPrintf("Q15 block gain: x%u\n\r", 1U << gainShift);
+    #else
+    (void)gainShift;
+    #endif // UART_DEBUG
+    arm_rfft_q15(pFftInstance, pAudioDataNormalized, pFftOutput);
+    calculateBandMagnitudesQ15(pFftOutput, pBand, pBandMag);
+}
 
-    int32_t mean = 0;
-    for (size_t i = 0; i < len; i++)
+/*
+ * Runs the Goertzel bank around the open-string frequency, with the frame length the full
+ * analysis would choose for that pitch, or stops it for the full analysis.
+ */
+void startGuidedTuning(const GuidedString guidedString)
+{
+    if (guidedString == GUIDED_STRING_NONE)
     {
-        mean += src[i];
+        stopGoertzelBank();
+        return;
     }
-    mean /= (int32_t)len;
-
-    #ifdef UART_LOG
-    uartPrintf("Mean: %ld\n\r", mean);
-    #endif // UART_LOG
+    const float32_t targetFrequency = GUIDED_STRING_FREQS[guidedString];
+    startGoertzelBank(targetFrequency, ANALYSIS_LEN_TABLE[chooseAnalysisLength(targetFrequency)]);
+}
 
-    for (size_t i = 0; i < len; i++)
+/*
+ * Updates the display from the sliding DFT until the next analysis block is ready. The
+ * bins refresh with every ADC chunk, the display as fast as the OLED transfer allows.
+ */
+void refreshFromSlidingDft()
+{
+    float32_t pBandMag[SLIDING_DFT_MAX_BINS];
+    SpectrumBand band;
+    while (!AUDIO_DATA_IS_ACTUAL)
     {
-        const int32_t centered = (int32_t)src[i] - mean;
-        dst[i] = (float32_t)centered / ADC_SCALE;
+        if (takeSlidingDftMagnitudes(pBandMag, &band))
+        {
+            waitForOledReadiness();
+            ssd1306_Clear();
+            calculateStringTuningInfoSliding(pBandMag, &band);
+            ssd1306_UpdateScreen();
+            continue;
+        }
+        HAL_SuspendTick();
+        HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+        HAL_ResumeTick();
     }
 }
+
+/*
+ * YIN, McLeod or the cepstrum on the unwindowed block, reusing the spectrum path's rfft
+ * instance and work buffers.
+ */
+float32_t timeDomainPitch(const arm_rfft_fast_instance_f32* pFftInstance, const uint16_t* pAudioHistory,
+                          const AudioBlock* pBlock)
+{
+    const uint16_t len = pBlock->length;
+    float32_t* pSamples = fftScratch.f32;
+    float32_t* pWork = fftScratch.f32 + AUDIO_MAX_DATA_LEN;
+    normalizeWithWindow(pAudioHistory, pBlock->startSample, pSamples, len, WINDOW_RECTANGULAR);
+    waitForOledReadiness();
+    ssd1306_Clear();
+    return calculateStringTuningInfoTimeDomain(pFftInstance, pSamples, pWork, len);
+}
+
+void showInfo()
+{
+    #ifdef UART_LOG
+    uartPrintf("Tuning info: empty\n\n\r");
+    #endif // UART_LOG
+}
@@ -0,0 +1,43 @@
+#include "window.h"
+#include "window_tables.h"
+
+/*
+ * Lookup of the analysis window tables. The tables are generated at build time by
+ * cmake/generate_window_tables.py and live in flash, one per window type and FFT size, in
+ * float32 and q15. The rectangular window has no table: the lookups return NULL for it and
+ * for a length without tables, and the caller then skips the weighting.
+ */
+
+WindowType ANALYSIS_WINDOW = WINDOW_HANN;
+
+static int8_t findWindowTableSize(const uint16_t length)
+{
+    for (uint8_t i = 0; i < WINDOW_TABLE_SIZE_COUNT; i++)
+    {
+        if (WINDOW_TABLE_SIZES[i] == length)
+        {
+            return (int8_t)i;
+        }
+    }
+    return -1;
+}
+
+const float32_t* getWindowTable(const WindowType type, const uint16_t length)
+{
+    const int8_t sizeIdx = findWindowTableSize(length);
+    if (type == WINDOW_RECTANGULAR || type >= WINDOW_TYPE_COUNT || sizeIdx < 0)
+    {
+        return NULL;
+    }
+    return WINDOW_TABLES_F32[type - WINDOW_HANN][sizeIdx];
+}
+
+const q15_t* getWindowTableQ15(const WindowType type, const uint16_t length)
+{
+    const int8_t sizeIdx = findWindowTableSize(length);
+    if (type == WINDOW_RECTANGULAR || type >= WINDOW_TYPE_COUNT || sizeIdx < 0)
+    {
+        return NULL;
+    }
+    return WINDOW_TABLES_Q15[type - WINDOW_HANN][sizeIdx];
+}
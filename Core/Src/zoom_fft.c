@@ -0,0 +1,182 @@
+#include "zoom_fft.h"
+#include "peak_interpolation.h"
+#include "signal_gate.h"
+#include "window.h"
+
+/*
+ * Zoom transform of the analysis block around the coarse spectrum peak fc:
+ *
+ * 1. Heterodyne: the windowed, DC-free samples are multiplied by exp(-j 2 pi fc n / fs), so
+ *    the partial moves to a few Hz around 0.
+ * 2. Decimation by ZOOM_DECIMATION with a triangular (second order CIC) filter. Its double
+ *    zeros sit on the multiples of the decimated rate, which is exactly where the components
+ *    that would alias onto the zoom span come from. Each input sample adds to two outputs,
+ *    so the block is read once and nothing but the decimated samples is stored.
+ * 3. A chirp-Z style evaluation of the decimated sequence at ZOOM_POINTS frequencies spread
+ *    over fc +/- ZOOM_HALF_SPAN_BINS coarse bins, with one phasor recursion per frequency.
+ *
+ * Over +/- 1 bin of a 2048-point spectrum at 8 kHz the grid is 0.12 Hz, and the parabola
+ * through the highest point and its neighbours lands within a few mHz of the maximum of the
+ * windowed DTFT. The memory is the decimated block, 2 KB for the longest one, where a plain
+ * rfft with the same grid would need 64k points.
+ *
+ * The stage runs from the first block of a note, unlike the phase vocoder, which then
+ * refines its result further when it has two frames.
+ */
+
+bool ZOOM_REFINEMENT = true;
+float32_t ZOOM_HALF_SPAN_BINS = 1.0f;
+
+static float32_t pZoomSamples[2 * (AUDIO_MAX_DATA_LEN / ZOOM_DECIMATION + 1)]; // Interleaved complex
+static float32_t pZoomPower[ZOOM_POINTS];
+
+static const uint16_t* pZoomHistory = NULL;
+static AudioBlock zoomBlock = {0};
+static uint16_t zoomBias = 0;
+
+void resetZoomFft()
+{
+    pZoomHistory = NULL;
+}
+
+/*
+ * Remembers the block of the spectrum and its DC bias for refineZoomFft(), which reads it
+ * from the history while it is still younger than AUDIO_HISTORY_LEN samples.
+ */
+void captureZoomBlock(const uint16_t* pAudioHistory, const AudioBlock* pBlock)
+{
+    if (!ZOOM_REFINEMENT)
+    {
+        return;
+    }
+
+    pZoomHistory = pAudioHistory;
+    zoomBlock = *pBlock;
+    zoomBias = SIGNAL_GATE_STATS.mean;
+}
+
+/*
+ * pPeakBin holds the fractional band index of the coarse peak and is replaced by the zoom
+ * estimate when the captured block matches pBand and the maximum lies inside the span.
+ */
+bool refineZoomFft(const SpectrumBand* pBand, float32_t* pPeakBin)
+{
+    if (!ZOOM_REFINEMENT || pZoomHistory == NULL || zoomBlock.length != pBand->fftLen)
+    {
+        return false;
+    }
+
+    const float32_t binWidth = ADC_SAMPLING_FREQ / (float32_t)pBand->fftLen;
+    const float32_t frequency = zoomPeakFrequency(pZoomHistory, zoomBlock.startSample, zoomBlock.length, zoomBias,
+                                                  calculateBinFrequency(pBand, *pPeakBin),
+                                                  ZOOM_HALF_SPAN_BINS * binWidth);
+    if (frequency <= 0.0f)
+    {
+        return false;
+    }
+
+    *pPeakBin = frequency / binWidth - (float32_t)pBand->firstBin;
+    return true;
+}
+
+/*
+ * Steps 1 and 2: fills pZoomSamples and returns the number of complex samples.
+ */
+static uint16_t heterodyneAndDecimate(const uint16_t* pAudioHistory, const uint32_t startSample,
+                                      const uint16_t length, const uint16_t bias, const float32_t centerFreq)
+{
+    const uint16_t outputCount = length / ZOOM_DECIMATION + 1;
+    const float32_t* pWindow = getWindowTable(ANALYSIS_WINDOW, length);
+    const float32_t step = 2.0f * PI * centerFreq / ADC_SAMPLING_FREQ;
+    const float32_t stepCos = arm_cos_f32(step);
+    const float32_t stepSin = arm_sin_f32(step);
+
+    pZoomSamples[0] = 0.0f; // Every later output is first written by the segment before it
+    pZoomSamples[1] = 0.0f;
+
+    uint16_t n = 0;
+    for (uint16_t m = 0; m + 1 < outputCount; m++)
+    {
+        // The phasor is reseeded every ZOOM_DECIMATION samples so its rounding cannot build up
+        const float32_t phase = fmodf(step * (float32_t)n, 2.0f * PI);
+        float32_t mixCos = arm_cos_f32(phase);
+        float32_t mixSin = arm_sin_f32(phase);
+        float32_t sumRe = 0.0f;
+        float32_t sumIm = 0.0f;
+        float32_t nextRe = 0.0f; // Share of the segment in the next output
+        float32_t nextIm = 0.0f;
+
+        for (uint16_t r = 0; r < ZOOM_DECIMATION; r++, n++)
+        {
+            float32_t sample = (float32_t)((int32_t)getAudioSample(pAudioHistory, startSample + n) - (int32_t)bias);
+            if (pWindow != NULL)
+            {
+                sample *= pWindow[getWindowTableIdx(n, length)];
+            }
+            const float32_t re = sample * mixCos;
+            const float32_t im = -sample * mixSin;
+            sumRe += (float32_t)(ZOOM_DECIMATION - r) * re;
+            sumIm += (float32_t)(ZOOM_DECIMATION - r) * im;
+            nextRe += (float32_t)r * re;
+            nextIm += (float32_t)r * im;
+
+            const float32_t rotatedCos = mixCos * stepCos - mixSin * stepSin;
+            mixSin = mixSin * stepCos + mixCos * stepSin;
+            mixCos = rotatedCos;
+        }
+        pZoomSamples[2 * m] += sumRe;
+        pZoomSamples[2 * m + 1] += sumIm;
+        pZoomSamples[2 * m + 2] = nextRe;
+        pZoomSamples[2 * m + 3] = nextIm;
+    }
+    return outputCount;
+}
+
+/*
+ * Frequency of the strongest component within centerFreq +/- halfSpan in the block, or 0
+ * when the maximum is on the edge of the span. bias is the DC level of the block in sample
+ * units. length must be a multiple of ZOOM_DECIMATION, at most AUDIO_MAX_DATA_LEN.
+ */
+float32_t zoomPeakFrequency(const uint16_t* pAudioHistory, const uint32_t startSample, const uint16_t length,
+                            const uint16_t bias, const float32_t centerFreq, const float32_t halfSpan)
+{
+    const uint16_t count = heterodyneAndDecimate(pAudioHistory, startSample, length, bias, centerFreq);
+    const float32_t pointSpacing = 2.0f * halfSpan / (float32_t)(ZOOM_POINTS - 1);
+
+    for (uint16_t k = 0; k < ZOOM_POINTS; k++)
+    {
+        const float32_t offset = -halfSpan + (float32_t)k * pointSpacing;
+        const float32_t step = 2.0f * PI * offset * (float32_t)ZOOM_DECIMATION / ADC_SAMPLING_FREQ;
+        const float32_t stepCos = arm_cos_f32(step);
+        const float32_t stepSin = arm_sin_f32(step);
+        float32_t kernelCos = 1.0f;
+        float32_t kernelSin = 0.0f;
+        float32_t sumRe = 0.0f;
+        float32_t sumIm = 0.0f;
+
+        for (uint16_t m = 0; m < count; m++)
+        {
+            const float32_t re = pZoomSamples[2 * m];
+            const float32_t im = pZoomSamples[2 * m + 1];
+            sumRe += re * kernelCos + im * kernelSin;
+            sumIm += im * kernelCos - re * kernelSin;
+
+            const float32_t rotatedCos = kernelCos * stepCos - kernelSin * stepSin;
+            kernelSin = kernelSin * stepCos + kernelCos * stepSin;
+            kernelCos = rotatedCos;
+        }
+        pZoomPower[k] = sumRe * sumRe + sumIm * sumIm;
+    }
+
+    float32_t maxPower = 0.0f;
+    uint32_t maxIdx = 0;
+    arm_max_f32(pZoomPower, ZOOM_POINTS, &maxPower, &maxIdx);
+    if (maxIdx == 0 || maxIdx == ZOOM_POINTS - 1)
+    {
+        return 0.0f;
+    }
+
+    // The grid is fine enough for the parabola whatever PEAK_INTERPOLATION is
+    const SpectralPeak peak = interpolatePeak(pZoomPower, ZOOM_POINTS, maxIdx, PEAK_INTERP_PARABOLIC);
+    return centerFreq - halfSpan + peak.bin * pointSpacing;
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Generates the flash-resident analysis window tables (window_tables.c/.h).
+
+Usage: generate_window_tables.py <output dir> <fft size>...
+
+Every window is the periodic (DFT-even) form of a cosine-sum window, so w[n] == w[N - n]
+and only entries 0..N/2 are stored. Each table exists in float32 and in q15.
+"""
+
+import math
+import os
+import sys
+
+# Name in C, cosine-sum coefficients a0, a1, ...: w[n] = sum (-1)^k * a_k * cos(2 pi k n / N)
+WINDOWS = [
+    ("HANN", [0.5, 0.5]),
+    ("BLACKMAN_HARRIS", [0.35875, 0.48829, 0.14128, 0.01168]),
+    ("FLAT_TOP", [0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368]),
+]
+
+
+def window_value(coeffs, n, size):
+    return sum((-1) ** k * a * math.cos(2.0 * math.pi * k * n / size) for k, a in enumerate(coeffs))
+
+
+def to_q15(value):
+    return max(-32768, min(32767, int(round(value * 32768.0))))
+
+
+def format_values(values, per_line):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("    " + ", ".join(values[i:i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    out_dir = sys.argv[1]
+    sizes = [int(size) for size in sys.argv[2:]]
+    os.makedirs(out_dir, exist_ok=True)
+
+    header = [
+        "// Generated by cmake/generate_window_tables.py, do not edit",
+        "#pragma once",
+        "",
+        "#include <arm_math.h>",
+        "",
+        "#define WINDOW_TABLE_TYPE_COUNT %d" % len(WINDOWS),
+        "#define WINDOW_TABLE_SIZE_COUNT %d" % len(sizes),
+        "",
+        "extern const uint16_t WINDOW_TABLE_SIZES[WINDOW_TABLE_SIZE_COUNT];",
+        "extern const float32_t* const WINDOW_TABLES_F32[WINDOW_TABLE_TYPE_COUNT][WINDOW_TABLE_SIZE_COUNT];",
+        "extern const q15_t* const WINDOW_TABLES_Q15[WINDOW_TABLE_TYPE_COUNT][WINDOW_TABLE_SIZE_COUNT];",
+        "",
+    ]
+
+    source = [
+        "// Generated by cmake/generate_window_tables.py, do not edit",
+        '#include "window_tables.h"',
+        "",
+        "const uint16_t WINDOW_TABLE_SIZES[WINDOW_TABLE_SIZE_COUNT] = {%s};" % ", ".join(map(str, sizes)),
+        "",
+    ]
+
+    for name, coeffs in WINDOWS:
+        for size in sizes:
+            values = [window_value(coeffs, n, size) for n in range(size // 2 + 1)]
+            source.append("static const float32_t WINDOW_%s_%d_F32[%d] = {" % (name, size, len(values)))
+            source.append(format_values(["%.9ef" % value for value in values], 6))
+            source.append("};")
+            source.append("")
+            source.append("static const q15_t WINDOW_%s_%d_Q15[%d] = {" % (name, size, len(values)))
+            source.append(format_values(["%d" % to_q15(value) for value in values], 12))
+            source.append("};")
+            source.append("")
+
+    for suffix, ctype in (("F32", "float32_t"), ("Q15", "q15_t")):
+        source.append("const %s* const WINDOW_TABLES_%s[WINDOW_TABLE_TYPE_COUNT][WINDOW_TABLE_SIZE_COUNT] = {" % (ctype, suffix))
+        for name, _ in WINDOWS:
+            source.append("    {%s}," % ", ".join("WINDOW_%s_%d_%s" % (name, size, suffix) for size in sizes))
+        source.append("};")
+        source.append("")
+
+    with open(os.path.join(out_dir, "window_tables.h"), "w") as file:
+        file.write("\n".join(header))
+    with open(os.path.join(out_dir, "window_tables.c"), "w") as file:
+        file.write("\n".join(source))
+
+
+if __name__ == "__main__":
+    main()